@@ -0,0 +1,269 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  asset_pack.c      - memory mapped pack of RGB565 images, RLE
+                      sprites and pre-rendered font atlases
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asset_pack.h"
+
+int asset_pack_open(asset_pack_t *pack, const char *fname)
+{
+  const asset_pack_hdr_t *hdr;
+  struct stat st;
+  void *mem;
+  int fd;
+
+  pack->base = NULL;
+  pack->size = 0;
+
+  fd = open(fname, O_RDONLY);
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(asset_pack_hdr_t)) {
+    close(fd);
+    return -1;
+  }
+
+  mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    return -1;
+
+  /* only the header and index are checked, entries when looked up */
+  hdr = mem;
+  if (memcmp(hdr->magic, ASSET_PACK_MAGIC, 4) || hdr->version != ASSET_PACK_VERSION ||
+      hdr->size != (uint64_t)st.st_size ||
+      sizeof(*hdr) + (size_t)hdr->count * sizeof(asset_pack_entry_t) > hdr->size) {
+    munmap(mem, st.st_size);
+    return -1;
+  }
+
+  pack->base = mem;
+  pack->size = st.st_size;
+  pack->index = (const asset_pack_entry_t *)(hdr + 1);
+  pack->count = hdr->count;
+
+  return 0;
+}
+
+void asset_pack_close(asset_pack_t *pack)
+{
+  if (pack->base != NULL)
+    munmap((void *)pack->base, pack->size);
+  pack->base = NULL;
+  pack->size = 0;
+  pack->count = 0;
+}
+
+const asset_pack_entry_t *asset_pack_find(const asset_pack_t *pack,
+                                          const char *name, int type)
+{
+  const asset_pack_entry_t *e;
+  int lo = 0, hi = pack->count;
+  int cmp;
+
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+
+    e = &pack->index[mid];
+    cmp = strncmp(name, e->name, ASSET_NAME_LEN);
+    if (cmp == 0) {
+      if ((type && e->type != type) || (e->offset % ASSET_PACK_ALIGN) ||
+          e->offset > pack->size || e->size > pack->size - e->offset)
+        return NULL;
+      return e;
+    }
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return NULL;
+}
+
+int asset_pack_image(const asset_pack_t *pack, const char *name,
+                     asset_image_t *img)
+{
+  const asset_pack_entry_t *e = asset_pack_find(pack, name, ASSET_TYPE_IMAGE);
+
+  /* 64-bit product, 32-bit size_t wraps for large dimensions */
+  if (e == NULL || e->size < (uint64_t)e->width * e->height * sizeof(uint16_t))
+    return -1;
+
+  img->pixels = (const uint16_t *)(pack->base + e->offset);
+  img->width = e->width;
+  img->height = e->height;
+
+  return 0;
+}
+
+int asset_pack_sprite(const asset_pack_t *pack, const char *name,
+                      asset_sprite_t *spr)
+{
+  const asset_pack_entry_t *e = asset_pack_find(pack, name, ASSET_TYPE_SPRITE);
+  size_t table;
+  int y;
+
+  if (e == NULL)
+    return -1;
+
+  table = (size_t)e->height * sizeof(uint32_t);
+  if (e->size < table)
+    return -1;
+
+  spr->row = (const uint32_t *)(pack->base + e->offset);
+  spr->runs = (const uint16_t *)(pack->base + e->offset + table);
+  spr->nruns = (e->size - table) / sizeof(uint16_t);
+  spr->width = e->width;
+  spr->height = e->height;
+
+  for (y = 0; spr->width && y < spr->height; y++)
+    if (spr->row[y] >= spr->nruns)
+      return -1;
+
+  return 0;
+}
+
+int asset_pack_font(const asset_pack_t *pack, const char *name,
+                    asset_font_t *font)
+{
+  const asset_pack_entry_t *e = asset_pack_find(pack, name, ASSET_TYPE_FONT);
+  const asset_pack_font_t *hdr;
+  uint64_t spans;
+
+  if (e == NULL || e->size < sizeof(*hdr))
+    return -1;
+
+  hdr = (const asset_pack_font_t *)(pack->base + e->offset);
+  spans = (uint64_t)hdr->count * e->height * e->width * sizeof(uint16_t);
+  if (e->size < sizeof(*hdr) + spans + hdr->count)
+    return -1;
+
+  memset(&font->desc, 0, sizeof(font->desc));
+  font->desc.name = (char *)e->name;
+  font->desc.maxwidth = e->width;
+  font->desc.height = e->height;
+  font->desc.ascent = hdr->ascent;
+  font->desc.firstchar = e->aux;
+  font->desc.size = hdr->count;
+  font->desc.width = (const unsigned char *)(hdr + 1) + spans;
+  font->desc.defaultchar = hdr->defaultchar;
+
+  /* the atlas only reads its tables, they stay in the mapping */
+  font->atlas.font = &font->desc;
+  font->atlas.fg = hdr->fg;
+  font->atlas.bg = hdr->bg;
+  font->atlas.stride = e->width;
+  font->atlas.spans = (uint16_t *)(hdr + 1);
+  font->atlas.width = (unsigned char *)font->desc.width;
+
+  return 0;
+}
+
+/* Visible part of w x h item at x, y in its own coordinates */
+static int asset_clip(fb_t *fb, const fb_rect_t *clip, int x, int y, int w, int h,
+                      fb_rect_t *v)
+{
+  v->x0 = (clip->x0 > 0? clip->x0: 0) - x;
+  v->y0 = (clip->y0 > 0? clip->y0: 0) - y;
+  v->x1 = (clip->x1 < fb->width? clip->x1: fb->width) - x;
+  v->y1 = (clip->y1 < fb->height? clip->y1: fb->height) - y;
+  if (v->x0 < 0)
+    v->x0 = 0;
+  if (v->y0 < 0)
+    v->y0 = 0;
+  if (v->x1 > w)
+    v->x1 = w;
+  if (v->y1 > h)
+    v->y1 = h;
+
+  return (v->x0 < v->x1) && (v->y0 < v->y1);
+}
+
+void asset_image_blit_clip(fb_t *fb, const asset_image_t *img, int x, int y,
+                           const fb_rect_t *clip)
+{
+  const uint16_t *src;
+  uint16_t *dst;
+  fb_rect_t v;
+  int cy;
+
+  if (!asset_clip(fb, clip, x, y, img->width, img->height, &v))
+    return;
+
+  src = img->pixels + v.y0 * img->width + v.x0;
+  dst = fb->pixels + (y + v.y0) * fb->width + x + v.x0;
+  for (cy = v.y0; cy < v.y1; cy++, src += img->width, dst += fb->width)
+    fb_kern.span_copy(dst, src, v.x1 - v.x0);
+}
+
+void asset_image_blit(fb_t *fb, const asset_image_t *img, int x, int y)
+{
+  fb_rect_t all = {0, 0, fb->width, fb->height};
+
+  asset_image_blit_clip(fb, img, x, y, &all);
+}
+
+void asset_sprite_blit_clip(fb_t *fb, const asset_sprite_t *spr, int x, int y,
+                            const fb_rect_t *clip)
+{
+  fb_rect_t v;
+  int cy;
+
+  if (!asset_clip(fb, clip, x, y, spr->width, spr->height, &v))
+    return;
+
+  for (cy = v.y0; cy < v.y1; cy++) {
+    const uint16_t *run = spr->runs + spr->row[cy];
+    const uint16_t *end = spr->runs + spr->nruns;
+    uint16_t *dst = fb->pixels + (y + cy) * fb->width + x;
+    int px = 0;
+
+    /* walk the runs, each clipped to the visible columns */
+    while (px < v.x1 && run < end) {
+      int kind = *run & ASSET_RLE_KIND_m;
+      int len = *run++ & ASSET_RLE_LEN_m;
+      int a = px < v.x0? v.x0: px;
+      int b = px + len > v.x1? v.x1: px + len;
+
+      if (len == 0)
+        break;
+      if (kind == ASSET_RLE_LIT) {
+        if (end - run < len)
+          break;
+        if (a < b)
+          fb_kern.span_copy(dst + a, run + (a - px), b - a);
+        run += len;
+      } else if (kind == ASSET_RLE_FILL) {
+        if (run >= end)
+          break;
+        if (a < b)
+          fb_kern.span_fill(dst + a, b - a, *run);
+        run++;
+      }
+      px += len;
+    }
+  }
+}
+
+void asset_sprite_blit(fb_t *fb, const asset_sprite_t *spr, int x, int y)
+{
+  fb_rect_t all = {0, 0, fb->width, fb->height};
+
+  asset_sprite_blit_clip(fb, spr, x, y, &all);
+}
@@ -0,0 +1,155 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  asset_pack.h      - memory mapped pack of RGB565 images, RLE
+                      sprites and pre-rendered font atlases
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "font_atlas.h"
+#include "font_types.h"
+#include "framebuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Pack layout, all fields little endian as on the board and the host:
+
+    asset_pack_hdr_t
+    asset_pack_entry_t index[count], sorted by name
+    entry data, each ASSET_PACK_ALIGN aligned
+
+  Image data are width * height RGB565 pixels row after row.
+
+  Sprite data start with uint32_t row[height], offsets of the rows in
+  16-bit words from the end of that table, followed by run tokens.
+  A token holds the run length in ASSET_RLE_LEN_m and its kind in the
+  upper bits: literal pixels follow it, fill has one color following,
+  skip leaves pixels transparent. Runs of a row sum up to width.
+
+  Font data are asset_pack_font_t, glyph spans in font_atlas_t layout
+  (count * height * width pixels) and count advance bytes.
+*/
+#define ASSET_PACK_MAGIC    "MZAP"
+#define ASSET_PACK_VERSION  1
+#define ASSET_PACK_ALIGN    32
+#define ASSET_NAME_LEN      24
+
+#define ASSET_TYPE_IMAGE    1
+#define ASSET_TYPE_SPRITE   2
+#define ASSET_TYPE_FONT     3
+
+#define ASSET_RLE_LIT       0x0000
+#define ASSET_RLE_FILL      0x4000
+#define ASSET_RLE_SKIP      0x8000
+#define ASSET_RLE_KIND_m    0xc000
+#define ASSET_RLE_LEN_m     0x3fff
+
+typedef struct asset_pack_hdr_t {
+  char     magic[4];
+  uint16_t version;
+  uint16_t count;
+  uint32_t size;        /* whole pack in bytes */
+  uint32_t reserved[5];
+} asset_pack_hdr_t;
+
+typedef struct asset_pack_entry_t {
+  char     name[ASSET_NAME_LEN];  /* zero padded */
+  uint16_t type;
+  uint16_t width;       /* atlas glyph stride for fonts */
+  uint16_t height;
+  uint16_t aux;         /* sprite key color, font first character */
+  uint32_t offset;      /* data from the pack start */
+  uint32_t size;
+} asset_pack_entry_t;
+
+typedef struct asset_pack_font_t {
+  uint16_t count;
+  uint16_t defaultchar;
+  uint16_t ascent;
+  uint16_t fg;
+  uint16_t bg;
+  uint16_t reserved[3];
+} asset_pack_font_t;
+
+/* Opened pack, views below point into its mapping */
+typedef struct asset_pack_t {
+  const unsigned char      *base;
+  size_t                    size;
+  const asset_pack_entry_t *index;
+  int                       count;
+} asset_pack_t;
+
+typedef struct asset_image_t {
+  const uint16_t *pixels;
+  int             width;
+  int             height;
+} asset_image_t;
+
+typedef struct asset_sprite_t {
+  const uint32_t *row;
+  const uint16_t *runs;
+  size_t          nruns;  /* 16-bit words of run tokens */
+  int             width;
+  int             height;
+} asset_sprite_t;
+
+/*
+  Descriptor and atlas refer to the mapped spans and widths, the atlas
+  must not be passed to font_atlas_free
+*/
+typedef struct asset_font_t {
+  font_descriptor_t desc;
+  font_atlas_t      atlas;
+} asset_font_t;
+
+/*
+  Maps the pack read only, the cost does not depend on its contents,
+  pages are read on first use. Returns -1 for missing or damaged file.
+*/
+int asset_pack_open(asset_pack_t *pack, const char *fname);
+
+void asset_pack_close(asset_pack_t *pack);
+
+/* Binary search of the index, type 0 matches any, NULL if not found */
+const asset_pack_entry_t *asset_pack_find(const asset_pack_t *pack,
+                                          const char *name, int type);
+
+int asset_pack_image(const asset_pack_t *pack, const char *name,
+                     asset_image_t *img);
+
+int asset_pack_sprite(const asset_pack_t *pack, const char *name,
+                      asset_sprite_t *spr);
+
+int asset_pack_font(const asset_pack_t *pack, const char *name,
+                    asset_font_t *font);
+
+/* Copies the image rows to the framebuffer, clipped */
+void asset_image_blit(fb_t *fb, const asset_image_t *img, int x, int y);
+
+/* Draws opaque runs of the sprite, clipped */
+void asset_sprite_blit(fb_t *fb, const asset_sprite_t *spr, int x, int y);
+
+/* Variants drawing only the part inside clip */
+void asset_image_blit_clip(fb_t *fb, const asset_image_t *img, int x, int y,
+                           const fb_rect_t *clip);
+
+void asset_sprite_blit_clip(fb_t *fb, const asset_sprite_t *spr, int x, int y,
+                            const fb_rect_t *clip);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*ASSET_PACK_H*/
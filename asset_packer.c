@@ -0,0 +1,438 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  asset_packer.c      - host tool building asset packs from PPM
+                        images and the built-in fonts
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "asset_pack.h"
+#include "font_atlas.h"
+#include "font_types.h"
+
+#define ASSET_PACKER_MAX  256
+
+typedef struct packer_entry_t {
+  asset_pack_entry_t e;
+  unsigned char     *data;
+} packer_entry_t;
+
+static packer_entry_t packer_entry[ASSET_PACKER_MAX];
+static int packer_count;
+
+static const struct {
+  const char        *name;
+  font_descriptor_t *font;
+} packer_fonts[] = {
+  {"rom8x16",   &font_rom8x16},
+  {"prop14x16", &font_winFreeSystem14x16},
+};
+
+/* Reads next PPM header number, skipping white space and comments */
+static int ppm_number(FILE *f)
+{
+  int c, v = 0;
+
+  do {
+    c = getc(f);
+    if (c == '#')
+      while (c != '\n' && c != EOF)
+        c = getc(f);
+  } while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+
+  if (c < '0' || c > '9')
+    return -1;
+  for (; c >= '0' && c <= '9'; c = getc(f))
+    v = v * 10 + c - '0';
+
+  return v;
+}
+
+/* Loads binary PPM (P6) converted to RGB565, NULL on failure */
+static uint16_t *ppm_load(const char *fname, int *width, int *height)
+{
+  FILE *f = fopen(fname, "rb");
+  uint16_t *pix = NULL;
+  int w, h, maxval, bpc;
+  long i, n;
+
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", fname);
+    return NULL;
+  }
+
+  if (getc(f) != 'P' || getc(f) != '6') {
+    fprintf(stderr, "%s: only binary PPM (P6) is supported\n", fname);
+    goto out;
+  }
+  w = ppm_number(f);
+  h = ppm_number(f);
+  maxval = ppm_number(f);
+  if (w <= 0 || h <= 0 || w > 0xffff || h > 0xffff || maxval <= 0 || maxval > 0xffff) {
+    fprintf(stderr, "%s: bad PPM header\n", fname);
+    goto out;
+  }
+  bpc = maxval > 255? 2: 1;
+
+  n = (long)w * h;
+  pix = malloc(n * sizeof(uint16_t));
+  if (pix == NULL)
+    goto out;
+
+  for (i = 0; i < n; i++) {
+    unsigned char b[6];
+    unsigned rgb[3];
+    int c;
+
+    if (fread(b, bpc, 3, f) != 3) {
+      fprintf(stderr, "%s: truncated\n", fname);
+      free(pix);
+      pix = NULL;
+      goto out;
+    }
+    for (c = 0; c < 3; c++) {
+      rgb[c] = bpc == 2? (b[2 * c] << 8) | b[2 * c + 1]: b[c];
+      rgb[c] = rgb[c] * 255 / maxval;
+    }
+    pix[i] = FB_RGB565(rgb[0], rgb[1], rgb[2]);
+  }
+  *width = w;
+  *height = h;
+
+out:
+  fclose(f);
+  return pix;
+}
+
+static packer_entry_t *packer_add(const char *name, int type)
+{
+  packer_entry_t *pe;
+  int i;
+
+  if (strlen(name) >= ASSET_NAME_LEN) {
+    fprintf(stderr, "asset name %s longer than %d characters\n",
+            name, ASSET_NAME_LEN - 1);
+    return NULL;
+  }
+  for (i = 0; i < packer_count; i++) {
+    if (!strcmp(packer_entry[i].e.name, name)) {
+      fprintf(stderr, "duplicate asset name %s\n", name);
+      return NULL;
+    }
+  }
+  if (packer_count >= ASSET_PACKER_MAX) {
+    fprintf(stderr, "more than %d assets\n", ASSET_PACKER_MAX);
+    return NULL;
+  }
+
+  pe = &packer_entry[packer_count++];
+  memset(pe, 0, sizeof(*pe));
+  strcpy(pe->e.name, name);
+  pe->e.type = type;
+
+  return pe;
+}
+
+/* Splits "name=value" argument, returns the value */
+static char *packer_split(char *arg)
+{
+  char *eq = strchr(arg, '=');
+
+  if (eq == NULL || eq == arg || !eq[1]) {
+    fprintf(stderr, "expected name=value, got %s\n", arg);
+    return NULL;
+  }
+  *eq = 0;
+
+  return eq + 1;
+}
+
+static int packer_image(char *arg)
+{
+  char *fname = packer_split(arg);
+  packer_entry_t *pe;
+  uint16_t *pix;
+  int w, h;
+
+  if (fname == NULL || (pix = ppm_load(fname, &w, &h)) == NULL)
+    return -1;
+  if ((pe = packer_add(arg, ASSET_TYPE_IMAGE)) == NULL) {
+    free(pix);
+    return -1;
+  }
+
+  pe->e.width = w;
+  pe->e.height = h;
+  pe->e.size = (uint32_t)w * h * sizeof(uint16_t);
+  pe->data = (unsigned char *)pix;
+
+  return 0;
+}
+
+/* Length of the run of equal pixels from x */
+static int rle_same(const uint16_t *row, int x, int w)
+{
+  int n = 1;
+
+  while (x + n < w && row[x + n] == row[x] && n < ASSET_RLE_LEN_m)
+    n++;
+
+  return n;
+}
+
+/* Encodes one row, returns number of 16-bit words stored to out */
+static long rle_row(const uint16_t *row, int w, uint16_t key, uint16_t *out)
+{
+  long o = 0;
+  int x = 0, n;
+
+  while (x < w) {
+    n = rle_same(row, x, w);
+    if (row[x] == key) {
+      out[o++] = ASSET_RLE_SKIP | n;
+    } else if (n >= 3) {
+      out[o++] = ASSET_RLE_FILL | n;
+      out[o++] = row[x];
+    } else {
+      /* literal up to the next key pixel or run worth a fill */
+      long hdr = o++;
+
+      n = 0;
+      while (x + n < w && n < ASSET_RLE_LEN_m && row[x + n] != key &&
+             rle_same(row, x + n, w) < 3) {
+        out[o++] = row[x + n];
+        n++;
+      }
+      out[hdr] = ASSET_RLE_LIT | n;
+    }
+    x += n;
+  }
+
+  return o;
+}
+
+static int packer_sprite(char *arg, uint16_t key)
+{
+  char *fname = packer_split(arg);
+  packer_entry_t *pe;
+  uint32_t *row;
+  uint16_t *runs;
+  uint16_t *pix;
+  long o = 0;
+  int w, h, y;
+
+  if (fname == NULL || (pix = ppm_load(fname, &w, &h)) == NULL)
+    return -1;
+  if ((pe = packer_add(arg, ASSET_TYPE_SPRITE)) == NULL) {
+    free(pix);
+    return -1;
+  }
+
+  /* a row never takes more than a token per pixel plus the pixel */
+  pe->data = malloc(h * sizeof(uint32_t) + (size_t)w * h * 2 * sizeof(uint16_t));
+  if (pe->data == NULL) {
+    free(pix);
+    return -1;
+  }
+  row = (uint32_t *)pe->data;
+  runs = (uint16_t *)(row + h);
+  for (y = 0; y < h; y++) {
+    row[y] = o;
+    o += rle_row(pix + (long)y * w, w, key, runs + o);
+  }
+  free(pix);
+
+  pe->e.width = w;
+  pe->e.height = h;
+  pe->e.aux = key;
+  pe->e.size = h * sizeof(uint32_t) + o * sizeof(uint16_t);
+
+  return 0;
+}
+
+static int packer_font(char *arg, uint16_t fg, uint16_t bg)
+{
+  char *font_name = packer_split(arg);
+  const font_descriptor_t *font = NULL;
+  asset_pack_font_t *hdr;
+  packer_entry_t *pe;
+  font_atlas_t atlas;
+  size_t spans;
+  unsigned i;
+
+  if (font_name == NULL)
+    return -1;
+  for (i = 0; i < sizeof(packer_fonts) / sizeof(packer_fonts[0]); i++)
+    if (!strcmp(packer_fonts[i].name, font_name))
+      font = packer_fonts[i].font;
+  if (font == NULL) {
+    fprintf(stderr, "unknown font %s, use rom8x16 or prop14x16\n", font_name);
+    return -1;
+  }
+
+  if ((pe = packer_add(arg, ASSET_TYPE_FONT)) == NULL)
+    return -1;
+  if (font_atlas_init(&atlas, font, fg, bg))
+    return -1;
+
+  spans = (size_t)font->size * font->height * atlas.stride * sizeof(uint16_t);
+  pe->e.size = sizeof(*hdr) + spans + font->size;
+  pe->data = calloc(1, pe->e.size);
+  if (pe->data == NULL) {
+    font_atlas_free(&atlas);
+    return -1;
+  }
+
+  hdr = (asset_pack_font_t *)pe->data;
+  hdr->count = font->size;
+  hdr->defaultchar = font->defaultchar;
+  hdr->ascent = font->ascent;
+  hdr->fg = fg;
+  hdr->bg = bg;
+  memcpy(hdr + 1, atlas.spans, spans);
+  memcpy((unsigned char *)(hdr + 1) + spans, atlas.width, font->size);
+  font_atlas_free(&atlas);
+
+  pe->e.width = atlas.stride;
+  pe->e.height = font->height;
+  pe->e.aux = font->firstchar;
+
+  return 0;
+}
+
+static int packer_cmp(const void *a, const void *b)
+{
+  return strncmp(((const packer_entry_t *)a)->e.name,
+                 ((const packer_entry_t *)b)->e.name, ASSET_NAME_LEN);
+}
+
+static int packer_write(const char *fname)
+{
+  static const unsigned char zero[ASSET_PACK_ALIGN];
+  asset_pack_hdr_t hdr;
+  uint32_t pos;
+  FILE *f;
+  int i;
+
+  qsort(packer_entry, packer_count, sizeof(packer_entry[0]), packer_cmp);
+
+  pos = sizeof(hdr) + packer_count * sizeof(asset_pack_entry_t);
+  for (i = 0; i < packer_count; i++) {
+    pos = (pos + ASSET_PACK_ALIGN - 1) & ~(ASSET_PACK_ALIGN - 1);
+    packer_entry[i].e.offset = pos;
+    pos += packer_entry[i].e.size;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, ASSET_PACK_MAGIC, 4);
+  hdr.version = ASSET_PACK_VERSION;
+  hdr.count = packer_count;
+  hdr.size = pos;
+
+  f = fopen(fname, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot write %s\n", fname);
+    return -1;
+  }
+
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  for (i = 0; i < packer_count; i++)
+    fwrite(&packer_entry[i].e, sizeof(asset_pack_entry_t), 1, f);
+  pos = sizeof(hdr) + packer_count * sizeof(asset_pack_entry_t);
+  for (i = 0; i < packer_count; i++) {
+    fwrite(zero, 1, packer_entry[i].e.offset - pos, f);
+    fwrite(packer_entry[i].data, 1, packer_entry[i].e.size, f);
+    pos = packer_entry[i].e.offset + packer_entry[i].e.size;
+  }
+
+  if (fclose(f)) {
+    fprintf(stderr, "cannot write %s\n", fname);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Parses RRGGBB hexadecimal color to RGB565 */
+static int packer_color(const char *s, uint16_t *color)
+{
+  char *end;
+  unsigned long v = strtoul(s, &end, 16);
+
+  if (end == s || *end || v > 0xffffff) {
+    fprintf(stderr, "expected RRGGBB color, got %s\n", s);
+    return -1;
+  }
+  *color = FB_RGB565(v >> 16, v >> 8, v);
+
+  return 0;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s -o pack [-i name=image.ppm] [-k RRGGBB] [-s name=sprite.ppm]\n"
+          "          [-c RRGGBB -b RRGGBB] [-f name=font] ...\n"
+          "  -i  RGB565 image\n"
+          "  -s  RLE sprite, pixels of the -k color (ff00ff) are transparent\n"
+          "  -f  font atlas rendered -c on -b, fonts rom8x16 and prop14x16\n"
+          "  options apply in order, PNG files convert with pngtopnm first\n",
+          argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out = NULL;
+  uint16_t key = FB_RGB565(0xff, 0x00, 0xff);
+  uint16_t fg = 0xffff, bg = 0x0000;
+  int opt, res = 0;
+
+  while ((opt = getopt(argc, argv, "o:i:s:f:k:c:b:h")) != -1) {
+    switch (opt) {
+      case 'o':
+        out = optarg;
+        break;
+      case 'i':
+        res = packer_image(optarg);
+        break;
+      case 's':
+        res = packer_sprite(optarg, key);
+        break;
+      case 'f':
+        res = packer_font(optarg, fg, bg);
+        break;
+      case 'k':
+        res = packer_color(optarg, &key);
+        break;
+      case 'c':
+        res = packer_color(optarg, &fg);
+        break;
+      case 'b':
+        res = packer_color(optarg, &bg);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h'? 0: 1;
+    }
+    if (res)
+      return 1;
+  }
+
+  if (out == NULL || optind != argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  return packer_write(out)? 1: 0;
+}
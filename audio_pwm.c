@@ -0,0 +1,180 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  audio_pwm.c      - real-time PCM sample streaming to audio PWM
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_pwm.h"
+#include "mzapo_regs.h"
+
+/* Deadlines missed by more periods than this restart the schedule */
+#define AUDIO_RESYNC_PERIODS 16
+
+static const long audio_jitter_bounds[AUDIO_JITTER_BINS] = AUDIO_JITTER_BOUNDS;
+
+static inline void audio_write_duty(audio_pwm_t *ap, int16_t sample)
+{
+  /* map -32768..32767 onto 0..pwm_period */
+  uint32_t duty = ((uint32_t)(sample + 32768) * (uint64_t)ap->pwm_period) >> 16;
+
+  *(volatile uint32_t *)(ap->audiopwm_mem_base + AUDIOPWM_REG_PWM_o) = duty;
+}
+
+static inline int64_t ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+  return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000 + (a->tv_nsec - b->tv_nsec);
+}
+
+static void audio_account_jitter(audio_pwm_t *ap, int64_t late_ns)
+{
+  long late_us = late_ns > 0? late_ns / 1000: 0;
+  int bin;
+
+  for (bin = 0; bin < AUDIO_JITTER_BINS - 1; bin++)
+    if (late_us < audio_jitter_bounds[bin])
+      break;
+  ap->stats.jitter_hist[bin]++;
+  if (late_us > ap->stats.jitter_max_us)
+    ap->stats.jitter_max_us = late_us;
+}
+
+static void *audio_pwm_thread(void *arg)
+{
+  audio_pwm_t *ap = (audio_pwm_t *)arg;
+  struct timespec next, now;
+  int64_t late;
+  unsigned tail;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!__atomic_load_n(&ap->stop, __ATOMIC_ACQUIRE)) {
+    next.tv_nsec += ap->sample_period_ns;
+    if (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    late = ts_diff_ns(&now, &next);
+    audio_account_jitter(ap, late);
+    if (late > AUDIO_RESYNC_PERIODS * ap->sample_period_ns) {
+      next = now;
+      ap->stats.resyncs++;
+    }
+
+    tail = ap->tail;
+    if (tail == __atomic_load_n(&ap->head, __ATOMIC_ACQUIRE)) {
+      if (ap->flowing) {
+        ap->stats.underruns++;
+        ap->flowing = 0;
+      }
+      ap->stats.idle_ticks++;
+      audio_write_duty(ap, 0);
+      continue;
+    }
+
+    audio_write_duty(ap, ap->ring[tail & (AUDIO_RING_LEN - 1)]);
+    __atomic_store_n(&ap->tail, tail + 1, __ATOMIC_RELEASE);
+    ap->flowing = 1;
+    ap->stats.samples++;
+  }
+
+  audio_write_duty(ap, 0);
+
+  return NULL;
+}
+
+int audio_pwm_start(audio_pwm_t *ap, unsigned char *audiopwm_mem_base,
+                    int sample_rate, uint32_t pwm_period, int rt_priority)
+{
+  pthread_attr_t attr;
+  struct sched_param sp;
+  int ret = -1;
+
+  memset(ap, 0, sizeof(*ap));
+  ap->audiopwm_mem_base = audiopwm_mem_base;
+  ap->pwm_period = pwm_period;
+  ap->sample_period_ns = 1000000000L / (sample_rate > 0? sample_rate: 8000);
+
+  *(volatile uint32_t *)(audiopwm_mem_base + AUDIOPWM_REG_PWMPER_o) = pwm_period;
+  audio_write_duty(ap, 0);
+
+  if (rt_priority > 0) {
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    sp.sched_priority = rt_priority;
+    pthread_attr_setschedparam(&attr, &sp);
+    ret = pthread_create(&ap->thread, &attr, audio_pwm_thread, ap);
+    pthread_attr_destroy(&attr);
+    ap->stats.realtime = ret == 0;
+  }
+
+  /* not privileged for real-time scheduling, play with best effort */
+  if (ret)
+    ret = pthread_create(&ap->thread, NULL, audio_pwm_thread, ap);
+
+  return ret? -1: 0;
+}
+
+void audio_pwm_stop(audio_pwm_t *ap)
+{
+  __atomic_store_n(&ap->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(ap->thread, NULL);
+}
+
+int audio_pwm_space(audio_pwm_t *ap)
+{
+  return AUDIO_RING_LEN - (ap->head - __atomic_load_n(&ap->tail, __ATOMIC_ACQUIRE));
+}
+
+int audio_pwm_write16(audio_pwm_t *ap, const int16_t *samples, int count)
+{
+  unsigned head = ap->head;
+  int space = audio_pwm_space(ap);
+  int i;
+
+  if (count > space)
+    count = space;
+  for (i = 0; i < count; i++)
+    ap->ring[(head + i) & (AUDIO_RING_LEN - 1)] = samples[i];
+  __atomic_store_n(&ap->head, head + count, __ATOMIC_RELEASE);
+
+  return count;
+}
+
+int audio_pwm_write8(audio_pwm_t *ap, const uint8_t *samples, int count)
+{
+  unsigned head = ap->head;
+  int space = audio_pwm_space(ap);
+  int i;
+
+  if (count > space)
+    count = space;
+  for (i = 0; i < count; i++)
+    ap->ring[(head + i) & (AUDIO_RING_LEN - 1)] = (int16_t)((samples[i] - 128) * 256);
+  __atomic_store_n(&ap->head, head + count, __ATOMIC_RELEASE);
+
+  return count;
+}
+
+void audio_pwm_get_stats(audio_pwm_t *ap, audio_pwm_stats_t *stats)
+{
+  /* counters are owned by the player thread, copy is not atomic */
+  *stats = ap->stats;
+}
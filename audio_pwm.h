@@ -0,0 +1,81 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  audio_pwm.h      - real-time PCM sample streaming to audio PWM
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef AUDIO_PWM_H
+#define AUDIO_PWM_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be power of two */
+#define AUDIO_RING_LEN      8192
+
+/* Wakeup lateness histogram bins, upper bounds in microseconds */
+#define AUDIO_JITTER_BINS   8
+#define AUDIO_JITTER_BOUNDS {5, 10, 20, 50, 100, 200, 500, 0x7fffffff}
+
+typedef struct audio_pwm_stats_t {
+  unsigned long samples;      /* played from the ring */
+  unsigned long underruns;    /* ring ran dry while samples were flowing */
+  unsigned long idle_ticks;   /* ticks with silence output */
+  unsigned long resyncs;      /* deadline reset after a long stall */
+  long          jitter_max_us;
+  unsigned long jitter_hist[AUDIO_JITTER_BINS];
+  int           realtime;     /* SCHED_FIFO was granted */
+} audio_pwm_stats_t;
+
+/*
+  Single producer (application) and single consumer (player thread)
+  ring of signed 16-bit samples. The player writes one duty value per
+  sample period at absolute clock_nanosleep() deadlines.
+*/
+typedef struct audio_pwm_t {
+  unsigned char    *audiopwm_mem_base;
+  uint32_t          pwm_period;
+  long              sample_period_ns;
+  int               stop;
+  int               flowing;
+  pthread_t         thread;
+  unsigned          head;
+  unsigned          tail;
+  audio_pwm_stats_t stats;
+  int16_t           ring[AUDIO_RING_LEN];
+} audio_pwm_t;
+
+/*
+  Sets PWM period to pwm_period ticks and starts the player. With
+  rt_priority nonzero the thread asks for SCHED_FIFO and falls back
+  to normal scheduling when it is not permitted.
+*/
+int audio_pwm_start(audio_pwm_t *ap, unsigned char *audiopwm_mem_base,
+                    int sample_rate, uint32_t pwm_period, int rt_priority);
+
+void audio_pwm_stop(audio_pwm_t *ap);
+
+/* Free space of the ring in samples */
+int audio_pwm_space(audio_pwm_t *ap);
+
+/* Queue signed 16-bit samples, returns number accepted */
+int audio_pwm_write16(audio_pwm_t *ap, const int16_t *samples, int count);
+
+/* Queue unsigned 8-bit samples, returns number accepted */
+int audio_pwm_write8(audio_pwm_t *ap, const uint8_t *samples, int count);
+
+void audio_pwm_get_stats(audio_pwm_t *ap, audio_pwm_stats_t *stats);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*AUDIO_PWM_H*/
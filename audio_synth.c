@@ -0,0 +1,271 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  audio_synth.c      - fixed-point tone synthesizer for audio PWM
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SYNTH_NEON 1
+#endif
+
+#include "audio_synth.h"
+
+/*
+ * Per voice gain fraction bits, envelope times amplitude is reduced
+ * to this so that all voices at full scale still fit the 32-bit mix
+ */
+#define SYNTH_GAIN_SHIFT 12
+
+/* One sine period, extra entry for interpolation past the end */
+static const int16_t synth_sine[257] = {
+       0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+    6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+   12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+   18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+   23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+   27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+   30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+   32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+   32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+   32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+   30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+   27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+   23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+   18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+   12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+    6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+       0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+   -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+  -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+  -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+  -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+  -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+  -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+  -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+  -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+  -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+  -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+  -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+  -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+  -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+  -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+   -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+       0,
+};
+
+static int32_t synth_env_rate(int ms, int sample_rate, int32_t span)
+{
+  int64_t blocks = (int64_t)ms * sample_rate / (1000 * SYNTH_BLOCK);
+
+  if (blocks < 1)
+    blocks = 1;
+  return span / blocks;
+}
+
+void synth_init(audio_synth_t *syn, int sample_rate)
+{
+  memset(syn, 0, sizeof(*syn));
+  syn->sample_rate = sample_rate;
+}
+
+void synth_note_on(audio_synth_t *syn, int voice, int wave, uint32_t freq_mhz,
+                   int amp, const synth_adsr_t *adsr)
+{
+  synth_voice_t *v = &syn->voice[voice];
+
+  v->wave = wave;
+  v->phase = 0;
+  /* 2^32 phase steps per period */
+  v->phase_inc = ((uint64_t)freq_mhz << 32) / ((uint64_t)syn->sample_rate * 1000);
+  v->amp = amp > 32767? 32767: amp;
+
+  if (adsr == NULL) {
+    v->env = SYNTH_ENV_ONE;
+    v->sustain = SYNTH_ENV_ONE;
+    v->attack_inc = SYNTH_ENV_ONE;
+    v->decay_dec = SYNTH_ENV_ONE;
+    v->release_dec = SYNTH_ENV_ONE;
+    v->env_state = SYNTH_ENV_SUSTAIN;
+    return;
+  }
+
+  v->sustain = (int32_t)adsr->sustain << 15;
+  v->attack_inc = synth_env_rate(adsr->attack_ms, syn->sample_rate, SYNTH_ENV_ONE);
+  v->decay_dec = synth_env_rate(adsr->decay_ms, syn->sample_rate,
+                                SYNTH_ENV_ONE - v->sustain);
+  v->release_dec = synth_env_rate(adsr->release_ms, syn->sample_rate, SYNTH_ENV_ONE);
+  if (v->decay_dec < 1)
+    v->decay_dec = 1;
+  v->env = 0;
+  v->env_state = SYNTH_ENV_ATTACK;
+}
+
+void synth_note_off(audio_synth_t *syn, int voice)
+{
+  synth_voice_t *v = &syn->voice[voice];
+
+  if (v->env_state != SYNTH_ENV_OFF)
+    v->env_state = SYNTH_ENV_RELEASE;
+}
+
+/*
+  Advances envelope by n samples, a partial block steps the same
+  fraction of the per block rate, returns the new level
+*/
+static int32_t synth_env_step(synth_voice_t *v, int n)
+{
+  int32_t step;
+
+  switch (v->env_state) {
+    case SYNTH_ENV_ATTACK:
+      step = (int64_t)v->attack_inc * n / SYNTH_BLOCK;
+      if (v->env >= SYNTH_ENV_ONE - step) {
+        v->env = SYNTH_ENV_ONE;
+        v->env_state = SYNTH_ENV_DECAY;
+      } else {
+        v->env += step;
+      }
+      break;
+    case SYNTH_ENV_DECAY:
+      step = (int64_t)v->decay_dec * n / SYNTH_BLOCK;
+      if (v->env - step <= v->sustain) {
+        v->env = v->sustain;
+        v->env_state = SYNTH_ENV_SUSTAIN;
+      } else {
+        v->env -= step;
+      }
+      break;
+    case SYNTH_ENV_RELEASE:
+      step = (int64_t)v->release_dec * n / SYNTH_BLOCK;
+      if (v->env <= step) {
+        v->env = 0;
+        v->env_state = SYNTH_ENV_OFF;
+      } else {
+        v->env -= step;
+      }
+      break;
+  }
+
+  return v->env;
+}
+
+static void synth_wave_block(synth_voice_t *v, int16_t *buf, int count)
+{
+  uint32_t phase = v->phase;
+  uint32_t inc = v->phase_inc;
+  int i;
+
+  switch (v->wave) {
+    case SYNTH_WAVE_SINE:
+      for (i = 0; i < count; i++, phase += inc) {
+        int idx = phase >> 24;
+        int32_t a = synth_sine[idx];
+        int32_t b = synth_sine[idx + 1];
+        buf[i] = a + (((b - a) * (int32_t)((phase >> 16) & 0xff)) >> 8);
+      }
+      break;
+    case SYNTH_WAVE_SAW:
+      for (i = 0; i < count; i++, phase += inc)
+        buf[i] = (int32_t)phase >> 16;
+      break;
+    case SYNTH_WAVE_TRIANGLE:
+      for (i = 0; i < count; i++, phase += inc) {
+        /* fold the upper half period back down */
+        uint32_t f = phase ^ (uint32_t)((int32_t)phase >> 31);
+        buf[i] = (int32_t)(f >> 15) - 32768;
+      }
+      break;
+    default:
+      for (i = 0; i < count; i++, phase += inc)
+        buf[i] = (int32_t)phase < 0? -32767: 32767;
+      break;
+  }
+
+  v->phase = phase;
+}
+
+/* acc += buf * gain, gain ramps linearly from g0 by step per sample */
+static void synth_mix_ramp(int32_t *acc, const int16_t *buf, int count,
+                           int32_t g0, int32_t step)
+{
+  int i = 0;
+
+#ifdef SYNTH_NEON
+  int32x4_t g = {g0, g0 + step, g0 + 2 * step, g0 + 3 * step};
+  int32x4_t g_step = vdupq_n_s32(4 * step);
+
+  for (; i + 4 <= count; i += 4) {
+    int32x4_t a = vld1q_s32(acc + i);
+    a = vmlal_s16(a, vld1_s16(buf + i), vmovn_s32(g));
+    vst1q_s32(acc + i, a);
+    g = vaddq_s32(g, g_step);
+  }
+  g0 += i * step;
+#endif
+
+  for (; i < count; i++, g0 += step)
+    acc[i] += buf[i] * g0;
+}
+
+/* out = saturate(acc >> SYNTH_GAIN_SHIFT) */
+static void synth_saturate(int16_t *out, const int32_t *acc, int count)
+{
+  int i = 0;
+
+#ifdef SYNTH_NEON
+  for (; i + 4 <= count; i += 4)
+    vst1_s16(out + i, vqshrn_n_s32(vld1q_s32(acc + i), SYNTH_GAIN_SHIFT));
+#endif
+
+  for (; i < count; i++) {
+    int32_t s = acc[i] >> SYNTH_GAIN_SHIFT;
+    out[i] = s > 32767? 32767: s < -32768? -32768: s;
+  }
+}
+
+void synth_render(audio_synth_t *syn, int16_t *out, int count)
+{
+  int32_t acc[SYNTH_BLOCK];
+  int16_t buf[SYNTH_BLOCK];
+  synth_voice_t *v;
+  int32_t g0, g1;
+  int n, k;
+
+  for (; count > 0; count -= n, out += n) {
+    n = count < SYNTH_BLOCK? count: SYNTH_BLOCK;
+    memset(acc, 0, n * sizeof(acc[0]));
+
+    for (k = 0; k < SYNTH_VOICES; k++) {
+      v = &syn->voice[k];
+      if (v->env_state == SYNTH_ENV_OFF)
+        continue;
+      g0 = (int32_t)(((int64_t)v->env * v->amp) >> (45 - SYNTH_GAIN_SHIFT));
+      g1 = (int32_t)(((int64_t)synth_env_step(v, n) * v->amp) >> (45 - SYNTH_GAIN_SHIFT));
+      synth_wave_block(v, buf, n);
+      synth_mix_ramp(acc, buf, n, g0, (g1 - g0) / n);
+    }
+
+    synth_saturate(out, acc, n);
+  }
+}
+
+int synth_feed(audio_synth_t *syn, audio_pwm_t *ap)
+{
+  int16_t block[SYNTH_BLOCK];
+  int done = 0;
+
+  while (audio_pwm_space(ap) >= SYNTH_BLOCK) {
+    synth_render(syn, block, SYNTH_BLOCK);
+    done += audio_pwm_write16(ap, block, SYNTH_BLOCK);
+  }
+
+  return done;
+}
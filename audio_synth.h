@@ -0,0 +1,83 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  audio_synth.h      - fixed-point tone synthesizer for audio PWM
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef AUDIO_SYNTH_H
+#define AUDIO_SYNTH_H
+
+#include <stdint.h>
+
+#include "audio_pwm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYNTH_VOICES      8
+/* Samples rendered at once, envelope is evaluated once per block */
+#define SYNTH_BLOCK       64
+
+#define SYNTH_WAVE_SQUARE    0
+#define SYNTH_WAVE_SINE      1
+#define SYNTH_WAVE_SAW       2
+#define SYNTH_WAVE_TRIANGLE  3
+
+#define SYNTH_ENV_OFF      0
+#define SYNTH_ENV_ATTACK   1
+#define SYNTH_ENV_DECAY    2
+#define SYNTH_ENV_SUSTAIN  3
+#define SYNTH_ENV_RELEASE  4
+
+/* Envelope level full scale, Q30 */
+#define SYNTH_ENV_ONE      (1 << 30)
+
+typedef struct synth_adsr_t {
+  int attack_ms;
+  int decay_ms;
+  int sustain;          /* level 0..32767 */
+  int release_ms;
+} synth_adsr_t;
+
+typedef struct synth_voice_t {
+  int      wave;
+  uint32_t phase;
+  uint32_t phase_inc;
+  int32_t  amp;         /* 0..32767 */
+  int      env_state;
+  int32_t  env;         /* Q30 level */
+  int32_t  attack_inc;  /* per block */
+  int32_t  decay_dec;
+  int32_t  sustain;
+  int32_t  release_dec;
+} synth_voice_t;
+
+typedef struct audio_synth_t {
+  int           sample_rate;
+  synth_voice_t voice[SYNTH_VOICES];
+} audio_synth_t;
+
+void synth_init(audio_synth_t *syn, int sample_rate);
+
+/* Starts note, frequency in millihertz, adsr NULL for plain gate */
+void synth_note_on(audio_synth_t *syn, int voice, int wave, uint32_t freq_mhz,
+                   int amp, const synth_adsr_t *adsr);
+
+void synth_note_off(audio_synth_t *syn, int voice);
+
+/* Mixes all active voices into count samples, saturated to 16 bits */
+void synth_render(audio_synth_t *syn, int16_t *out, int count);
+
+/* Renders as many whole blocks as the player ring accepts */
+int synth_feed(audio_synth_t *syn, audio_pwm_t *ap);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*AUDIO_SYNTH_H*/
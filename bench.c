@@ -0,0 +1,513 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  bench.c      - pixel transfer and rendering throughput benchmark
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "framebuffer.h"
+#include "fb_damage.h"
+#include "fb_async.h"
+#include "fb_draw.h"
+#include "fb_scene.h"
+#include "fb_scroll.h"
+#include "font_atlas.h"
+#include "mzapo_parlcd.h"
+#include "mzapo_phys.h"
+#include "mzapo_regs.h"
+#include "mzapo_sim.h"
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS "unknown"
+#endif
+
+typedef struct bench_ctx_t {
+  unsigned char *parlcd_mem_base;
+  fb_t           fb;
+  fb_damage_t    dmg;
+  font_atlas_t   atlas;
+  fb_async_t     async;
+  fb_pacer_t     pacer;
+  fb_scroll_t    scroll;
+  fb_scene_t     scene;
+  fb_node_t     *scene_node[3];
+  int            frame;
+} bench_ctx_t;
+
+/* One frame of the measured operation, returns number of pixels */
+typedef long bench_fnc_t(bench_ctx_t *ctx);
+
+/* Optional preparation and cleanup around the measured frames */
+typedef int bench_setup_t(bench_ctx_t *ctx, int start);
+
+typedef struct bench_case_t {
+  const char    *name;
+  bench_fnc_t   *fnc;
+  bench_setup_t *setup;
+} bench_case_t;
+
+static const char bench_text[] =
+  "Knob R: 123  G: 045  B: 210  Speed 1500 rpm  Pos 0000123456";
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long bench_write_data(bench_ctx_t *ctx)
+{
+  uint16_t *p = ctx->fb.pixels;
+  long n = (long)ctx->fb.width * ctx->fb.height;
+  long i;
+
+  parlcd_write_cmd(ctx->parlcd_mem_base, 0x2c);
+  for (i = 0; i < n; i++)
+    parlcd_write_data(ctx->parlcd_mem_base, p[i]);
+
+  return n;
+}
+
+static long bench_write_data2x(bench_ctx_t *ctx)
+{
+  uint16_t *p = ctx->fb.pixels;
+  long n = (long)ctx->fb.width * ctx->fb.height;
+  long i;
+
+  parlcd_write_cmd(ctx->parlcd_mem_base, 0x2c);
+  for (i = 0; i < n; i += 2)
+    parlcd_write_data2x(ctx->parlcd_mem_base, p[i] | ((uint32_t)p[i + 1] << 16));
+
+  return n;
+}
+
+static long bench_fb_flush(bench_ctx_t *ctx)
+{
+  fb_flush(&ctx->fb, ctx->parlcd_mem_base);
+
+  return (long)ctx->fb.width * ctx->fb.height;
+}
+
+static long bench_fill_full(bench_ctx_t *ctx)
+{
+  fb_fill(&ctx->fb, ctx->frame & 1? 0xf800: 0x001f);
+
+  return (long)ctx->fb.width * ctx->fb.height;
+}
+
+static long bench_fill_rect(bench_ctx_t *ctx)
+{
+  fb_rect_t r;
+  long n = 0;
+  int i;
+
+  /* 64 rectangles 40x24 scattered over the screen */
+  for (i = 0; i < 64; i++) {
+    r.x0 = (i * 37 + ctx->frame) % (ctx->fb.width - 40);
+    r.y0 = (i * 53) % (ctx->fb.height - 24);
+    r.x1 = r.x0 + 40;
+    r.y1 = r.y0 + 24;
+    fb_fill_rect(&ctx->fb, &r, i * 0x0421);
+    n += 40 * 24;
+  }
+
+  return n;
+}
+
+static long bench_draw_prims(bench_ctx_t *ctx)
+{
+  fb_draw_t dc;
+  fb_point_t tri[3];
+  long n = 0;
+  int i, x, y;
+
+  fb_draw_init(&dc, &ctx->fb);
+
+  /* pixel counts are approximate for circles and triangles */
+  for (i = 0; i < 32; i++) {
+    y = (i * 29 + ctx->frame) % ctx->fb.height;
+    fb_draw_line(&dc, 0, y, ctx->fb.width - 1, ctx->fb.height - 1 - y, i * 0x0841);
+    n += ctx->fb.width;
+  }
+  for (i = 0; i < 16; i++) {
+    x = 24 + (i * 61 + ctx->frame) % (ctx->fb.width - 48);
+    y = 24 + (i * 43) % (ctx->fb.height - 48);
+    fb_draw_circle_fill(&dc, x, y, 20, i * 0x1082);
+    n += 1257;
+  }
+  for (i = 0; i < 8; i++) {
+    x = (i * 53 + ctx->frame) % (ctx->fb.width - 60);
+    y = (i * 37) % (ctx->fb.height - 60);
+    tri[0].x = x;      tri[0].y = y;
+    tri[1].x = x + 60; tri[1].y = y + 20;
+    tri[2].x = x + 20; tri[2].y = y + 60;
+    fb_draw_polygon_fill(&dc, tri, 3, i * 0x2104);
+    n += 1600;
+  }
+
+  return n;
+}
+
+/* reference renderer testing glyph bits pixel by pixel */
+static long bench_text_per_bit(bench_ctx_t *ctx)
+{
+  const font_descriptor_t *font = &font_rom8x16;
+  const char *text;
+  long n = 0;
+  int x, y;
+
+  for (y = 0; y < ctx->fb.height / (int)font->height; y++) {
+    x = 0;
+    for (text = bench_text; *text; text++) {
+      int idx = font_glyph_index(font, (unsigned char)*text);
+      int w = font_glyph_width(font, idx);
+      const font_bits_t *bits = font_glyph_bits(font, idx);
+      int row, col;
+
+      for (row = 0; row < (int)font->height; row++)
+        for (col = 0; col < w; col++)
+          fb_put_pixel(&ctx->fb, x + col, y * font->height + row,
+                       (bits[row] & (0x8000 >> col))? 0xffff: 0x0000);
+      x += w;
+      n += w * font->height;
+    }
+  }
+
+  return n;
+}
+
+static long bench_text_atlas(bench_ctx_t *ctx)
+{
+  int height = ctx->atlas.font->height;
+  long n = 0;
+  int y;
+
+  for (y = 0; y < ctx->fb.height / height; y++)
+    n += (long)font_atlas_draw_text(&ctx->fb, &ctx->atlas, 0, y * height,
+                                    bench_text) * height;
+
+  return n;
+}
+
+static long bench_partial_update(bench_ctx_t *ctx)
+{
+  long n;
+
+  /* counter and two knob readouts changing each frame */
+  fb_damage_clear(&ctx->dmg);
+  fb_damage_add(&ctx->dmg, 10, 10, 96, 16);
+  fb_damage_add(&ctx->dmg, 300, 200, 48, 16);
+  fb_damage_add(&ctx->dmg, 352, 200, 48, 16);
+
+  n = fb_damage_area(&ctx->dmg);
+  fb_flush_damage(&ctx->fb, &ctx->dmg, ctx->parlcd_mem_base);
+
+  return n;
+}
+
+static int bench_async_setup(bench_ctx_t *ctx, int start)
+{
+  if (!start) {
+    fb_async_stop(&ctx->async);
+    return 0;
+  }
+
+  return fb_async_start(&ctx->async, ctx->parlcd_mem_base, FB_ASYNC_DROP_STALE,
+                        NULL);
+}
+
+/* application side cost of a frame, transfer runs in the flush thread */
+static long bench_async_submit(bench_ctx_t *ctx)
+{
+  fb_t *fb = fb_async_back(&ctx->async);
+
+  fb_fill(fb, ctx->frame & 1? 0x07e0: 0x001f);
+  fb_async_submit(&ctx->async);
+
+  return (long)fb->width * fb->height;
+}
+
+static int bench_paced_setup(bench_ctx_t *ctx, int start)
+{
+  fb_pacer_stats_t st;
+
+  if (start) {
+    fb_pacer_init(&ctx->pacer, 60);
+    return fb_async_start(&ctx->async, ctx->parlcd_mem_base, FB_ASYNC_DROP_STALE,
+                          &ctx->pacer);
+  }
+
+  fb_async_stop(&ctx->async);
+  fb_pacer_get_stats(&ctx->pacer, &st);
+  printf("bench=paced_stats refresh_hz=60 frames=%lu coalesced=%lu missed=%lu"
+         " latency_min_us=%ld latency_avg_us=%ld latency_max_us=%ld\n",
+         st.frames, st.coalesced, st.missed,
+         st.latency_min_us, st.latency_avg_us, st.latency_max_us);
+
+  return 0;
+}
+
+/* application producing frames at 500 Hz paced to 60 Hz refresh */
+static long bench_paced_submit(bench_ctx_t *ctx)
+{
+  struct timespec app_period = {.tv_sec = 0, .tv_nsec = 2 * 1000 * 1000};
+
+  nanosleep(&app_period, NULL);
+
+  return bench_async_submit(ctx);
+}
+
+static int bench_scroll_setup(bench_ctx_t *ctx, int start)
+{
+  uint8_t madctl = parlcd_controller_madctl(parlcd_default_controller());
+
+  if (!start) {
+    fb_scroll_fini(&ctx->scroll, ctx->parlcd_mem_base);
+    return 0;
+  }
+
+  return fb_scroll_init(&ctx->scroll, &ctx->fb, ctx->parlcd_mem_base, madctl,
+                        0, madctl & PARLCD_MADCTL_MV_m? ctx->fb.width: ctx->fb.height);
+}
+
+/* log view adding one text line per frame, the rest is scrolled */
+static long bench_scroll_log(bench_ctx_t *ctx)
+{
+  int lines = ctx->atlas.font->height;
+  fb_rect_t r[2];
+  long n = 0;
+  int i, cnt;
+
+  cnt = fb_scroll_next(&ctx->scroll, lines, r);
+  for (i = 0; i < cnt; i++) {
+    fb_fill_rect(&ctx->fb, &r[i], 0x0000);
+    /* columns on the landscape controllers, text must not leave them */
+    font_atlas_draw_text_clip(&ctx->fb, &ctx->atlas, r[i].x0, r[i].y0,
+                              bench_text, &r[i]);
+    n += (long)(r[i].x1 - r[i].x0) * (r[i].y1 - r[i].y0);
+  }
+  fb_scroll_push(&ctx->scroll, lines, ctx->parlcd_mem_base);
+
+  return n;
+}
+
+static void bench_gauge_draw(fb_draw_t *dc, const fb_node_t *node)
+{
+  const fb_rect_t *b = &node->bounds;
+  int frame = *(const int *)node->u.widget.ctx;
+  int cx = (b->x0 + b->x1) / 2, cy = (b->y0 + b->y1) / 2;
+  static const signed char dir[8][2] = {{30, 0}, {21, 21}, {0, 30}, {-21, 21},
+                                        {-30, 0}, {-21, -21}, {0, -30}, {21, -21}};
+
+  fb_draw_circle_fill(dc, cx, cy, 32, 0x2104);
+  fb_draw_line(dc, cx, cy, cx + dir[frame & 7][0], cy + dir[frame & 7][1], 0xffe0);
+}
+
+/* dashboard of static panels and labels with a few live elements */
+static int bench_scene_setup(bench_ctx_t *ctx, int start)
+{
+  fb_scene_t *sc = &ctx->scene;
+  int height = ctx->atlas.font->height;
+  fb_rect_t r;
+  int i;
+
+  if (!start) {
+    fb_scene_free(sc);
+    return 0;
+  }
+
+  if (fb_scene_init(sc, &ctx->fb, 64, 0x0000))
+    return -1;
+
+  for (i = 0; i < 6; i++) {
+    r.x0 = (i % 3) * 160 + 4;
+    r.y0 = (i / 3) * 160 + 4;
+    r.x1 = r.x0 + 152;
+    r.y1 = r.y0 + 152;
+    fb_scene_rect(sc, &r, 0x18e3 + i * 0x0821);
+  }
+  for (i = 0; i < 24; i++)
+    fb_scene_text(sc, &ctx->atlas, (i % 3) * 160 + 8, (i / 12) * 160 + 8 +
+                  (i / 3 % 4) * height, "Speed 1500 rpm");
+
+  r.x0 = 360;
+  r.y0 = 200;
+  r.x1 = r.x0 + 72;
+  r.y1 = r.y0 + 72;
+  ctx->scene_node[0] = fb_scene_text(sc, &ctx->atlas, 168, 250, "Pos 0000000000");
+  ctx->scene_node[1] = fb_scene_rect(sc, &r, 0xf800);
+  ctx->scene_node[2] = fb_scene_widget(sc, &r, bench_gauge_draw, &ctx->frame);
+  fb_scene_move(sc, ctx->scene_node[1], 8, 250);
+
+  fb_scene_flush(sc, ctx->parlcd_mem_base);
+
+  return 0;
+}
+
+static long bench_scene_update(bench_ctx_t *ctx)
+{
+  fb_scene_t *sc = &ctx->scene;
+  char buf[32];
+
+  snprintf(buf, sizeof(buf), "Pos %010d", ctx->frame * 37);
+  fb_scene_set_text(sc, ctx->scene_node[0], buf);
+  fb_scene_move(sc, ctx->scene_node[1], 8 + ctx->frame % 64, 250);
+  fb_scene_invalidate(sc, ctx->scene_node[2]);
+
+  return fb_scene_flush(sc, ctx->parlcd_mem_base);
+}
+
+/* the same scene repainted and sent whole as immediate mode would */
+static long bench_scene_full(bench_ctx_t *ctx)
+{
+  fb_damage_add(&ctx->scene.dmg, 0, 0, ctx->fb.width, ctx->fb.height);
+
+  return bench_scene_update(ctx);
+}
+
+static const bench_case_t bench_cases[] = {
+  {"write_data",     bench_write_data},
+  {"write_data2x",   bench_write_data2x},
+  {"fb_flush",       bench_fb_flush},
+  {"fill_full",      bench_fill_full},
+  {"fill_rect",      bench_fill_rect},
+  {"draw_prims",     bench_draw_prims},
+  {"text_per_bit",   bench_text_per_bit},
+  {"text_atlas",     bench_text_atlas},
+  {"partial_update", bench_partial_update},
+  {"scroll_log",     bench_scroll_log, bench_scroll_setup},
+  {"scene_update",   bench_scene_update, bench_scene_setup},
+  {"scene_full",     bench_scene_full, bench_scene_setup},
+  {"async_submit",   bench_async_submit, bench_async_setup},
+  {"paced_submit",   bench_paced_submit, bench_paced_setup},
+};
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [-d|-s] [-i] [-n frames] [case ...]\n"
+          "  -d  use real LCD through /dev/mem\n"
+          "  -s  use simulated registers (MZAPO_SIM file)\n"
+          "  -i  initialize the LCD controller first\n"
+          "  results are printed one line per case as key=value pairs\n",
+          argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  bench_ctx_t ctx;
+  const char *backend_name;
+  int frames = 200;
+  int do_init = 0;
+  int backend_set = 0;
+  double t;
+  long pixels;
+  int opt;
+  int i, f, a;
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  while ((opt = getopt(argc, argv, "dsin:h")) != -1) {
+    switch (opt) {
+      case 'd':
+        map_phys_set_backend(MAP_PHYS_BACKEND_DEVMEM, NULL);
+        backend_set = 1;
+        break;
+      case 's':
+        map_phys_set_backend(MAP_PHYS_BACKEND_SIM, NULL);
+        backend_set = 1;
+        break;
+      case 'i':
+        do_init = 1;
+        break;
+      case 'n':
+        frames = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h'? 0: 1;
+    }
+  }
+
+  if (frames <= 0)
+    frames = 1;
+
+#if !defined(__arm__) && !defined(__aarch64__)
+  /* host builds default to the simulation, there is no LCD around */
+  if (!backend_set && (getenv(MZAPO_SIM_ENV) == NULL))
+    map_phys_set_backend(MAP_PHYS_BACKEND_SIM, NULL);
+#endif
+
+  backend_name = map_phys_get_backend() == MAP_PHYS_BACKEND_SIM? "sim": "devmem";
+
+  ctx.parlcd_mem_base = map_phys_address(PARLCD_REG_BASE_PHYS, PARLCD_REG_SIZE, 0);
+  if (ctx.parlcd_mem_base == NULL)
+    return 1;
+
+  if (fb_init(&ctx.fb, PARLCD_WIDTH, PARLCD_HEIGHT) ||
+      font_atlas_init(&ctx.atlas, &font_rom8x16, 0xffff, 0x0000)) {
+    fprintf(stderr, "cannot allocate benchmark buffers\n");
+    return 1;
+  }
+
+  if (do_init) {
+    t = bench_now();
+    parlcd_hx8357_init(ctx.parlcd_mem_base);
+    printf("bench=lcd_init backend=%s seconds=%.6f\n",
+           backend_name, bench_now() - t);
+  }
+
+  for (i = 0; i < (int)(sizeof(bench_cases) / sizeof(bench_cases[0])); i++) {
+    const bench_case_t *bc = &bench_cases[i];
+
+    if (optind < argc) {
+      for (a = optind; a < argc; a++)
+        if (!strcmp(argv[a], bc->name))
+          break;
+      if (a == argc)
+        continue;
+    }
+
+    if (bc->setup && bc->setup(&ctx, 1)) {
+      fprintf(stderr, "bench %s setup failed\n", bc->name);
+      continue;
+    }
+
+    fb_fill(&ctx.fb, 0x0000);
+    pixels = 0;
+    t = bench_now();
+    for (f = 0; f < frames; f++) {
+      ctx.frame = f;
+      pixels += bc->fnc(&ctx);
+    }
+    t = bench_now() - t;
+
+    if (bc->setup)
+      bc->setup(&ctx, 0);
+
+    printf("bench=%s backend=%s cflags=\"%s\" frames=%d pixels=%ld"
+           " seconds=%.6f pixels_per_s=%.0f frames_per_s=%.1f\n",
+           bc->name, backend_name, BENCH_CFLAGS, frames, pixels,
+           t, pixels / t, frames / t);
+  }
+
+  font_atlas_free(&ctx.atlas);
+  fb_free(&ctx.fb);
+  unmap_phys_address(ctx.parlcd_mem_base);
+
+  return 0;
+}
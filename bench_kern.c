@@ -0,0 +1,150 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  bench_kern.c      - RGB565 span kernel throughput in bytes/cycle
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "fb_kernels.h"
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS "unknown"
+#endif
+
+#define BENCH_ROWS  32
+#define BENCH_ROW   480
+
+static uint16_t bench_src[BENCH_ROWS * BENCH_ROW] __attribute__((aligned(64)));
+static uint16_t bench_dst[BENCH_ROWS * BENCH_ROW] __attribute__((aligned(64)));
+
+static const char *kern_names[] = {
+  "span_fill", "span_copy", "span_copy_key", "span_blend50", "span_blend"
+};
+
+static int cycles_fd = -1;
+
+static int cycles_open(void)
+{
+  struct perf_event_attr pe;
+
+  memset(&pe, 0, sizeof(pe));
+  pe.type = PERF_TYPE_HARDWARE;
+  pe.size = sizeof(pe);
+  pe.config = PERF_COUNT_HW_CPU_CYCLES;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  cycles_fd = syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+
+  return cycles_fd;
+}
+
+static uint64_t cycles_read(void)
+{
+  uint64_t v = 0;
+
+  if (read(cycles_fd, &v, sizeof(v)) != sizeof(v))
+    return 0;
+  return v;
+}
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_kernel(const fb_kernels_t *k, int kern, int len, int offs)
+{
+  uint16_t *d;
+  const uint16_t *s;
+  int row;
+
+  for (row = 0; row < BENCH_ROWS; row++) {
+    d = bench_dst + row * BENCH_ROW + offs;
+    s = bench_src + row * BENCH_ROW + offs;
+    switch (kern) {
+      case 0: k->span_fill(d, len, row * 0x0841); break;
+      case 1: k->span_copy(d, s, len); break;
+      case 2: k->span_copy_key(d, s, len, 0xf81f); break;
+      case 3: k->span_blend50(d, s, len); break;
+      case 4: k->span_blend(d, s, len, 96); break;
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  static const int lens[] = {16, 100, BENCH_ROW - 1};
+  const fb_kernels_t *impl[2];
+  double mhz = 0, t;
+  uint64_t c0, c;
+  long rounds = 2000, r;
+  int nimpl = 0, i, kern, l, opt;
+
+  while ((opt = getopt(argc, argv, "f:n:")) != -1) {
+    switch (opt) {
+      case 'f':
+        mhz = atof(optarg);
+        break;
+      case 'n':
+        rounds = atol(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-f cpu_mhz] [-n rounds]\n"
+                "  cycles come from perf events, -f converts time when\n"
+                "  they are not available\n", argv[0]);
+        return 1;
+    }
+  }
+
+  impl[nimpl++] = &fb_kernels_scalar;
+  if (fb_kernels_neon && !fb_kernels_select(FB_KERNELS_NEON))
+    impl[nimpl++] = fb_kernels_neon;
+
+  if ((cycles_open() < 0) && (mhz <= 0))
+    fprintf(stderr, "no cycle counter, pass -f cpu_mhz for bytes/cycle\n");
+
+  for (i = 0; i < BENCH_ROWS * BENCH_ROW; i++)
+    bench_src[i] = (i * 2654435761u) >> 16;
+
+  for (i = 0; i < nimpl; i++) {
+    for (kern = 0; kern < 5; kern++) {
+      for (l = 0; l < (int)(sizeof(lens) / sizeof(lens[0])); l++) {
+        run_kernel(impl[i], kern, lens[l], 1);
+
+        c0 = cycles_fd >= 0? cycles_read(): 0;
+        t = bench_now();
+        /* odd start pixel, the unaligned head is part of the cost */
+        for (r = 0; r < rounds; r++)
+          run_kernel(impl[i], kern, lens[l], 1);
+        t = bench_now() - t;
+        c = cycles_fd >= 0? cycles_read() - c0: (uint64_t)(t * mhz * 1e6);
+
+        printf("bench=%s impl=%s cflags=\"%s\" span=%d bytes=%ld seconds=%.6f"
+               " cycles=%llu bytes_per_cycle=%.3f\n",
+               kern_names[kern], impl[i]->name, BENCH_CFLAGS, lens[l],
+               rounds * BENCH_ROWS * lens[l] * 2L, t, (unsigned long long)c,
+               c? (double)rounds * BENCH_ROWS * lens[l] * 2 / c: 0.0);
+      }
+    }
+  }
+
+  return 0;
+}
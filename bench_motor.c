@@ -0,0 +1,133 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  bench_motor.c      - PID motor control step response and loop
+                       timing benchmark
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "motor_ctl.h"
+#include "mzapo_phys.h"
+#include "mzapo_regs.h"
+
+#define TRACE_MAX  10000
+
+static int64_t trace[TRACE_MAX];
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [-r loop_hz] [-s step_counts] [-t trace_ms]\n"
+          "          [-p kp] [-i ki] [-d kd] [-c cpu] [-R rt_prio]\n"
+          "  gains are Q16, on the host run against mzapo_sim\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  motor_pid_t pid = {.kp = 300 << 16, .ki = 1 << 16, .kd = 3 << 16};
+  struct timespec tick = {.tv_sec = 0, .tv_nsec = 1000000};
+  unsigned char *dcspdrv_mem_base;
+  motor_irc_snapshot_t snap;
+  motor_ctl_stats_t st;
+  static motor_ctl_t mc;
+  int loop_hz = 2000, step = 2000, trace_ms = 1000;
+  int cpu = 0, rt_prio = 80;
+  int64_t start, target, mag, peak = 0, v, err;
+  int i, n, opt, rise_lo = -1, rise_hi = -1, settle = -1;
+
+  while ((opt = getopt(argc, argv, "r:s:t:p:i:d:c:R:h")) != -1) {
+    switch (opt) {
+      case 'r': loop_hz = atoi(optarg); break;
+      case 's': step = atoi(optarg); break;
+      case 't': trace_ms = atoi(optarg); break;
+      case 'p': pid.kp = atoi(optarg); break;
+      case 'i': pid.ki = atoi(optarg); break;
+      case 'd': pid.kd = atoi(optarg); break;
+      case 'c': cpu = atoi(optarg); break;
+      case 'R': rt_prio = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return opt == 'h'? 0: 1;
+    }
+  }
+  /* at least one sample, the final error is the last one */
+  if (trace_ms < 1)
+    trace_ms = 1;
+  if (trace_ms > TRACE_MAX)
+    trace_ms = TRACE_MAX;
+
+#if !defined(__arm__) && !defined(__aarch64__)
+  /* host build talks to the emulator */
+  if (map_phys_get_backend() != MAP_PHYS_BACKEND_SIM)
+    map_phys_set_backend(MAP_PHYS_BACKEND_SIM, NULL);
+#endif
+
+  dcspdrv_mem_base = map_phys_address(DCSPDRV_REG_BASE_PHYS_0, DCSPDRV_REG_SIZE, 0);
+  if (dcspdrv_mem_base == NULL)
+    return 1;
+
+  if (motor_ctl_init(&mc, dcspdrv_mem_base, NULL, 5000, loop_hz, 2) ||
+      motor_ctl_start(&mc, rt_prio, cpu)) {
+    fprintf(stderr, "cannot start motor control\n");
+    return 1;
+  }
+
+  motor_irc_read(&mc.irc, &snap);
+  start = snap.axis[0].pos;
+  target = start + step;
+  motor_ctl_set_pid(&mc, 0, &pid);
+  motor_ctl_set_position(&mc, 0, target);
+
+  /* 1 ms trace of the step response */
+  for (n = 0; n < trace_ms; n++) {
+    nanosleep(&tick, NULL);
+    motor_irc_read(&mc.irc, &snap);
+    trace[n] = snap.axis[0].pos - start;
+  }
+
+  motor_ctl_get_stats(&mc, &st);
+  motor_ctl_stop(&mc);
+
+  /* evaluated in the direction of the step */
+  mag = step < 0? -step: step;
+  for (i = 0; i < n; i++) {
+    v = step < 0? -trace[i]: trace[i];
+    if (rise_lo < 0 && v * 10 >= mag)
+      rise_lo = i;
+    if (rise_hi < 0 && v * 10 >= mag * 9)
+      rise_hi = i;
+    if (v > peak)
+      peak = v;
+    err = v - mag;
+    if ((err < 0? -err: err) * 50 > mag)
+      settle = -1;
+    else if (settle < 0)
+      settle = i;
+  }
+
+  printf("bench=motor_step loop_hz=%d step=%d rise_ms=%d overshoot_pct=%.1f"
+         " settle_ms=%d final_err=%lld\n",
+         loop_hz, step, (rise_lo >= 0 && rise_hi >= 0)? rise_hi - rise_lo: -1,
+         peak > mag? 100.0 * (peak - mag) / mag: 0.0, settle,
+         (long long)(trace[n - 1] - step));
+  printf("bench=motor_loop realtime=%d pinned=%d locked=%d loops=%lu overruns=%lu"
+         " period_min_us=%.1f period_max_us=%.1f wcet_us=%.1f jitter_hist=",
+         st.realtime, st.pinned, st.locked, st.loops, st.overruns,
+         st.period_min_ns / 1000.0, st.period_max_ns / 1000.0, st.wcet_ns / 1000.0);
+  for (i = 0; i < MOTOR_JITTER_BINS; i++)
+    printf("%s%lu", i? ",": "", st.jitter_hist[i]);
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  bench_synth.c      - audio synthesizer CPU load benchmark
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_synth.h"
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS "unknown"
+#endif
+
+static const char *wave_name[] = {"square", "sine", "saw", "triangle"};
+
+static double cpu_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+  static int16_t out[4096];
+  synth_adsr_t adsr = {5, 50, 20000, 100};
+  audio_synth_t syn;
+  int rate = 44100;
+  int seconds = 10;
+  int voices, wave, i, opt;
+  long n, total;
+  double t, load;
+  int32_t check;
+
+  while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+    switch (opt) {
+      case 'r':
+        rate = atoi(optarg);
+        break;
+      case 's':
+        seconds = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-r rate] [-s audio_seconds]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  for (wave = SYNTH_WAVE_SQUARE; wave <= SYNTH_WAVE_TRIANGLE; wave++) {
+    for (voices = 1; voices <= SYNTH_VOICES; voices *= 2) {
+      synth_init(&syn, rate);
+      for (i = 0; i < voices; i++)
+        synth_note_on(&syn, i, wave, 220000 + 110000 * i, 32767, &adsr);
+
+      total = (long)rate * seconds;
+      check = 0;
+      t = cpu_seconds();
+      for (n = 0; n < total; n += sizeof(out) / sizeof(out[0])) {
+        synth_render(&syn, out, sizeof(out) / sizeof(out[0]));
+        check += out[(n >> 12) & 4095];
+      }
+      t = cpu_seconds() - t;
+      load = 100.0 * t / seconds;
+
+      printf("bench=synth wave=%s cflags=\"%s\" rate=%d voices=%d"
+             " cpu_seconds=%.6f load_pct=%.4f voices_per_pct=%.1f check=%d\n",
+             wave_name[wave], BENCH_CFLAGS, rate, voices, t, load,
+             load > 0? voices / load: 0.0, (int)check);
+    }
+  }
+
+  return 0;
+}
@@ -28,12 +28,16 @@
 
 int main(int argc, char *argv[])
 {
+  serialize_lock_info_t lock_info;
 
   /* Serialize execution of applications */
 
   /* Try to acquire lock the first */
   if (serialize_lock(1) <= 0) {
     printf("System is occupied\n");
+    if (!serialize_lock_get_info(&lock_info))
+      printf("Held by pid %d, %d jobs queued\n",
+             lock_info.holder_pid, lock_info.queue_depth);
 
     if (1) {
       printf("Waitting\n");
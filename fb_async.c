@@ -0,0 +1,145 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_async.c      - double buffered LCD output with flush thread
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "fb_async.h"
+#include "mzapo_parlcd.h"
+
+static int fb_async_take(fb_async_t *fa)
+{
+  unsigned prev;
+
+  if (!(__atomic_load_n(&fa->pending, __ATOMIC_ACQUIRE) & FB_ASYNC_NEW_m))
+    return 0;
+
+  prev = __atomic_exchange_n(&fa->pending, fa->front, __ATOMIC_ACQ_REL);
+  fa->front = prev & FB_ASYNC_IDX_m;
+  sem_post(&fa->taken);
+
+  return 1;
+}
+
+static void fb_async_flush_front(fb_async_t *fa)
+{
+  fb_flush(&fa->buf[fa->front], fa->parlcd_mem_base);
+  __atomic_add_fetch(&fa->flushed, 1, __ATOMIC_RELAXED);
+  if (fa->pacer != NULL)
+    fb_pacer_frame_done(fa->pacer, &fa->submit_time[fa->front]);
+}
+
+static void *fb_async_thread(void *arg)
+{
+  fb_async_t *fa = (fb_async_t *)arg;
+  struct timespec vsync;
+
+  while (!__atomic_load_n(&fa->stop, __ATOMIC_ACQUIRE)) {
+    while (sem_wait(&fa->wake) && (errno == EINTR))
+      ;
+    if (!(__atomic_load_n(&fa->pending, __ATOMIC_ACQUIRE) & FB_ASYNC_NEW_m))
+      continue;
+    /* take the newest frame only once the sync slot arrives */
+    if (fa->pacer != NULL)
+      fb_pacer_wait(fa->pacer, &vsync);
+    if (fb_async_take(fa))
+      fb_async_flush_front(fa);
+  }
+
+  if (fb_async_take(fa))
+    fb_async_flush_front(fa);
+
+  return NULL;
+}
+
+int fb_async_start(fb_async_t *fa, unsigned char *parlcd_mem_base, int policy,
+                   fb_pacer_t *pacer)
+{
+  int i;
+
+  fa->parlcd_mem_base = parlcd_mem_base;
+  fa->policy = policy;
+  fa->pacer = pacer;
+  fa->stop = 0;
+  fa->back = 0;
+  fa->pending = 1;
+  fa->front = 2;
+  fa->submitted = 0;
+  fa->flushed = 0;
+  fa->dropped = 0;
+
+  for (i = 0; i < 3; i++) {
+    if (fb_init(&fa->buf[i], PARLCD_WIDTH, PARLCD_HEIGHT)) {
+      while (i--)
+        fb_free(&fa->buf[i]);
+      return -1;
+    }
+    fb_fill(&fa->buf[i], 0);
+  }
+
+  sem_init(&fa->wake, 0, 0);
+  sem_init(&fa->taken, 0, 0);
+
+  if (pthread_create(&fa->thread, NULL, fb_async_thread, fa)) {
+    for (i = 0; i < 3; i++)
+      fb_free(&fa->buf[i]);
+    sem_destroy(&fa->wake);
+    sem_destroy(&fa->taken);
+    return -1;
+  }
+
+  return 0;
+}
+
+void fb_async_stop(fb_async_t *fa)
+{
+  int i;
+
+  __atomic_store_n(&fa->stop, 1, __ATOMIC_RELEASE);
+  sem_post(&fa->wake);
+  pthread_join(fa->thread, NULL);
+
+  for (i = 0; i < 3; i++)
+    fb_free(&fa->buf[i]);
+  sem_destroy(&fa->wake);
+  sem_destroy(&fa->taken);
+}
+
+fb_t *fb_async_submit(fb_async_t *fa)
+{
+  unsigned prev;
+
+  if (fa->policy == FB_ASYNC_WAIT_FREE) {
+    while (__atomic_load_n(&fa->pending, __ATOMIC_ACQUIRE) & FB_ASYNC_NEW_m)
+      while (sem_wait(&fa->taken) && (errno == EINTR))
+        ;
+  }
+
+  if (fa->pacer != NULL)
+    clock_gettime(CLOCK_MONOTONIC, &fa->submit_time[fa->back]);
+
+  prev = __atomic_exchange_n(&fa->pending, fa->back | FB_ASYNC_NEW_m,
+                             __ATOMIC_ACQ_REL);
+  if (prev & FB_ASYNC_NEW_m) {
+    __atomic_add_fetch(&fa->dropped, 1, __ATOMIC_RELAXED);
+    if (fa->pacer != NULL)
+      __atomic_add_fetch(&fa->pacer->coalesced, 1, __ATOMIC_RELAXED);
+  }
+
+  fa->back = prev & FB_ASYNC_IDX_m;
+  fa->submitted++;
+  sem_post(&fa->wake);
+
+  return &fa->buf[fa->back];
+}
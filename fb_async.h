@@ -0,0 +1,82 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_async.h      - double buffered LCD output with flush thread
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_ASYNC_H
+#define FB_ASYNC_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "framebuffer.h"
+#include "fb_pacer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Submit waits until the flush thread has taken the previous frame */
+#define FB_ASYNC_WAIT_FREE   0
+/* Newer frame replaces the one the flush thread has not started yet */
+#define FB_ASYNC_DROP_STALE  1
+
+#define FB_ASYNC_NEW_m       0x100
+#define FB_ASYNC_IDX_m       0x0ff
+
+/*
+  Three buffers rotate between the application (back), the handoff
+  slot (pending) and the flush thread (front). The slot is swapped
+  with an atomic exchange, so neither side ever takes a lock.
+*/
+typedef struct fb_async_t {
+  unsigned char *parlcd_mem_base;
+  fb_t          buf[3];
+  int           back;
+  int           front;
+  unsigned      pending;      /* buffer index | FB_ASYNC_NEW_m */
+  int           policy;
+  fb_pacer_t   *pacer;
+  struct timespec submit_time[3];
+  int           stop;
+  sem_t         wake;
+  sem_t         taken;
+  pthread_t     thread;
+  unsigned long submitted;
+  unsigned long flushed;
+  unsigned long dropped;
+} fb_async_t;
+
+/*
+  With pacer the transfers wait for vertical sync, at most one per
+  refresh period, frames submitted meanwhile coalesce into it.
+*/
+int fb_async_start(fb_async_t *fa, unsigned char *parlcd_mem_base, int policy,
+                   fb_pacer_t *pacer);
+
+/* Transfers frame still pending, then terminates the flush thread */
+void fb_async_stop(fb_async_t *fa);
+
+/* Buffer the application renders into */
+static inline fb_t *fb_async_back(fb_async_t *fa)
+{
+  return &fa->buf[fa->back];
+}
+
+/*
+  Hands the back buffer over for transfer and returns the next one.
+  Its content is not defined, it holds some older frame.
+*/
+fb_t *fb_async_submit(fb_async_t *fa);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_ASYNC_H*/
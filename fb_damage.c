@@ -0,0 +1,115 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_damage.c      - dirty rectangle tracking for partial LCD updates
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#include "fb_damage.h"
+
+static inline long rect_area(const fb_rect_t *r)
+{
+  return (long)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static inline void rect_union(fb_rect_t *u, const fb_rect_t *a, const fb_rect_t *b)
+{
+  u->x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+  u->y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+  u->x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+  u->y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+}
+
+static inline int rect_overlap(const fb_rect_t *a, const fb_rect_t *b)
+{
+  return (a->x0 < b->x1) && (b->x0 < a->x1) &&
+         (a->y0 < b->y1) && (b->y0 < a->y1);
+}
+
+void fb_damage_clear(fb_damage_t *dmg)
+{
+  dmg->count = 0;
+}
+
+void fb_damage_add(fb_damage_t *dmg, int x, int y, int width, int height)
+{
+  fb_rect_t r = {x, y, x + width, y + height};
+
+  fb_damage_add_rect(dmg, &r);
+}
+
+void fb_damage_add_rect(fb_damage_t *dmg, const fb_rect_t *r)
+{
+  fb_rect_t nr = *r;
+  fb_rect_t u;
+  long best_waste;
+  int best;
+  int i;
+
+  if ((nr.x0 >= nr.x1) || (nr.y0 >= nr.y1))
+    return;
+
+  /*
+    Absorb every rectangle which overlaps the new one or is close enough
+    that one window is cheaper than two. The grown rectangle can reach
+    further ones, so rescan after each merge.
+  */
+  i = 0;
+  while (i < dmg->count) {
+    rect_union(&u, &nr, &dmg->rect[i]);
+    if (rect_overlap(&nr, &dmg->rect[i]) ||
+        (rect_area(&u) - rect_area(&nr) - rect_area(&dmg->rect[i]) <
+         FB_DAMAGE_WINDOW_COST)) {
+      nr = u;
+      dmg->rect[i] = dmg->rect[--dmg->count];
+      i = 0;
+      continue;
+    }
+    i++;
+  }
+
+  if (dmg->count < FB_DAMAGE_MAX) {
+    dmg->rect[dmg->count++] = nr;
+    return;
+  }
+
+  /* tracker full, grow the rectangle which wastes the least */
+  best = 0;
+  best_waste = -1;
+  for (i = 0; i < dmg->count; i++) {
+    long waste;
+    rect_union(&u, &nr, &dmg->rect[i]);
+    waste = rect_area(&u) - rect_area(&dmg->rect[i]);
+    if ((best_waste < 0) || (waste < best_waste)) {
+      best_waste = waste;
+      best = i;
+    }
+  }
+  rect_union(&u, &nr, &dmg->rect[best]);
+  dmg->rect[best] = dmg->rect[--dmg->count];
+  fb_damage_add_rect(dmg, &u);
+}
+
+long fb_damage_area(const fb_damage_t *dmg)
+{
+  long area = 0;
+  int i;
+
+  for (i = 0; i < dmg->count; i++)
+    area += rect_area(&dmg->rect[i]);
+
+  return area;
+}
+
+void fb_flush_damage(fb_t *fb, fb_damage_t *dmg, unsigned char *parlcd_mem_base)
+{
+  int i;
+
+  for (i = 0; i < dmg->count; i++)
+    fb_flush_rect(fb, &dmg->rect[i], parlcd_mem_base);
+
+  dmg->count = 0;
+}
@@ -0,0 +1,49 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_damage.h      - dirty rectangle tracking for partial LCD updates
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_DAMAGE_H
+#define FB_DAMAGE_H
+
+#include "framebuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_DAMAGE_MAX  16
+
+/*
+  Cost of a separate window update expressed in pixels. Two rectangles
+  are merged when the bounding box wastes less than this on the bus.
+*/
+#define FB_DAMAGE_WINDOW_COST  64
+
+typedef struct fb_damage_t {
+  int       count;
+  fb_rect_t rect[FB_DAMAGE_MAX];
+} fb_damage_t;
+
+void fb_damage_clear(fb_damage_t *dmg);
+
+void fb_damage_add(fb_damage_t *dmg, int x, int y, int width, int height);
+
+void fb_damage_add_rect(fb_damage_t *dmg, const fb_rect_t *r);
+
+/* Returns number of pixels covered by the merged rectangles */
+long fb_damage_area(const fb_damage_t *dmg);
+
+/* Sends all damaged rectangles to the LCD and clears the tracker */
+void fb_flush_damage(fb_t *fb, fb_damage_t *dmg, unsigned char *parlcd_mem_base);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_DAMAGE_H*/
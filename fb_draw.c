@@ -0,0 +1,248 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_draw.c      - span based 2D primitives with clip stack
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "fb_draw.h"
+
+void fb_draw_init(fb_draw_t *dc, fb_t *fb)
+{
+  dc->fb = fb;
+  dc->depth = 0;
+  dc->clip[0].x0 = 0;
+  dc->clip[0].y0 = 0;
+  dc->clip[0].x1 = fb->width;
+  dc->clip[0].y1 = fb->height;
+}
+
+int fb_draw_clip_push(fb_draw_t *dc, const fb_rect_t *r)
+{
+  const fb_rect_t *c = &dc->clip[dc->depth];
+  fb_rect_t *n;
+
+  if (dc->depth >= FB_CLIP_DEPTH)
+    return -1;
+
+  n = &dc->clip[++dc->depth];
+  n->x0 = r->x0 > c->x0? r->x0: c->x0;
+  n->y0 = r->y0 > c->y0? r->y0: c->y0;
+  n->x1 = r->x1 < c->x1? r->x1: c->x1;
+  n->y1 = r->y1 < c->y1? r->y1: c->y1;
+  /* empty clip stays empty, spans are rejected by x0 >= x1 */
+  if (n->x1 < n->x0)
+    n->x1 = n->x0;
+  if (n->y1 < n->y0)
+    n->y1 = n->y0;
+
+  return 0;
+}
+
+void fb_draw_clip_pop(fb_draw_t *dc)
+{
+  if (dc->depth > 0)
+    dc->depth--;
+}
+
+void fb_draw_rect_fill(fb_draw_t *dc, const fb_rect_t *r, uint16_t color)
+{
+  const fb_rect_t *c = &dc->clip[dc->depth];
+  int y0 = r->y0 > c->y0? r->y0: c->y0;
+  int y1 = r->y1 < c->y1? r->y1: c->y1;
+  int y;
+
+  for (y = y0; y < y1; y++)
+    fb_draw_hspan(dc, y, r->x0, r->x1, color);
+}
+
+void fb_draw_rect(fb_draw_t *dc, const fb_rect_t *r, uint16_t color)
+{
+  int y;
+
+  if ((r->x0 >= r->x1) || (r->y0 >= r->y1))
+    return;
+
+  fb_draw_hspan(dc, r->y0, r->x0, r->x1, color);
+  if (r->y1 - 1 > r->y0)
+    fb_draw_hspan(dc, r->y1 - 1, r->x0, r->x1, color);
+  for (y = r->y0 + 1; y < r->y1 - 1; y++) {
+    fb_draw_hspan(dc, y, r->x0, r->x0 + 1, color);
+    if (r->x1 - 1 > r->x0)
+      fb_draw_hspan(dc, y, r->x1 - 1, r->x1, color);
+  }
+}
+
+void fb_draw_line(fb_draw_t *dc, int x0, int y0, int x1, int y1, uint16_t color)
+{
+  int dx = abs(x1 - x0);
+  int dy = -abs(y1 - y0);
+  int sx = x0 < x1? 1: -1;
+  int sy = y0 < y1? 1: -1;
+  int err = dx + dy;
+  int run_x = x0;
+  int e2;
+
+  /* pixels sharing a row are collected into one span */
+  for (;;) {
+    if ((x0 == x1) && (y0 == y1))
+      break;
+    e2 = 2 * err;
+    if (e2 <= dx) {
+      /* row changes, emit what was collected on this one */
+      if (sx > 0)
+        fb_draw_hspan(dc, y0, run_x, x0 + 1, color);
+      else
+        fb_draw_hspan(dc, y0, x0, run_x + 1, color);
+      if (e2 >= dy) {
+        err += dy;
+        x0 += sx;
+      }
+      err += dx;
+      y0 += sy;
+      run_x = x0;
+      continue;
+    }
+    err += dy;
+    x0 += sx;
+  }
+
+  if (sx > 0)
+    fb_draw_hspan(dc, y0, run_x, x0 + 1, color);
+  else
+    fb_draw_hspan(dc, y0, x0, run_x + 1, color);
+}
+
+/* Pixels xa..xb of the top and bottom arcs on rows cy +- y */
+static void fb_draw_circle_run(fb_draw_t *dc, int cx, int cy, int y,
+                               int xa, int xb, uint16_t color)
+{
+  fb_draw_hspan(dc, cy - y, cx - xb, cx - xa + 1, color);
+  fb_draw_hspan(dc, cy - y, cx + xa, cx + xb + 1, color);
+  if (y) {
+    fb_draw_hspan(dc, cy + y, cx - xb, cx - xa + 1, color);
+    fb_draw_hspan(dc, cy + y, cx + xa, cx + xb + 1, color);
+  }
+}
+
+void fb_draw_circle(fb_draw_t *dc, int cx, int cy, int r, uint16_t color)
+{
+  int x = 0, y = r;
+  int d = 1 - r;
+  int run = 0;
+
+  if (r < 0)
+    return;
+
+  /*
+    Top and bottom octants advance along x, their pixels on one row
+    are collected into a run. Side octants get one pixel per row.
+  */
+  while (x <= y) {
+    fb_draw_hspan(dc, cy + x, cx - y, cx - y + 1, color);
+    fb_draw_hspan(dc, cy + x, cx + y, cx + y + 1, color);
+    if (x) {
+      fb_draw_hspan(dc, cy - x, cx - y, cx - y + 1, color);
+      fb_draw_hspan(dc, cy - x, cx + y, cx + y + 1, color);
+    }
+
+    if (d < 0) {
+      d += 2 * x + 3;
+    } else {
+      fb_draw_circle_run(dc, cx, cy, y, run, x, color);
+      d += 2 * (x - y) + 5;
+      y--;
+      run = x + 1;
+    }
+    x++;
+  }
+
+  if (run <= x - 1)
+    fb_draw_circle_run(dc, cx, cy, y, run, x - 1, color);
+}
+
+void fb_draw_circle_fill(fb_draw_t *dc, int cx, int cy, int r, uint16_t color)
+{
+  int x = 0, y = r;
+  int d = 1 - r;
+
+  if (r < 0)
+    return;
+
+  while (x <= y) {
+    /* rows cy +- x get their span each step, they never repeat */
+    fb_draw_hspan(dc, cy + x, cx - y, cx + y + 1, color);
+    if (x)
+      fb_draw_hspan(dc, cy - x, cx - y, cx + y + 1, color);
+
+    if (d < 0) {
+      d += 2 * x + 3;
+    } else {
+      /* rows cy +- y are done once y is about to change */
+      if (y > x) {
+        fb_draw_hspan(dc, cy + y, cx - x, cx + x + 1, color);
+        fb_draw_hspan(dc, cy - y, cx - x, cx + x + 1, color);
+      }
+      d += 2 * (x - y) + 5;
+      y--;
+    }
+    x++;
+  }
+}
+
+int fb_draw_polygon_fill(fb_draw_t *dc, const fb_point_t *pts, int count,
+                         uint16_t color)
+{
+  const fb_rect_t *c = &dc->clip[dc->depth];
+  int32_t xs[FB_POLY_MAX];
+  int ymin, ymax, y, i, j, n;
+  int64_t yc;
+  int32_t t;
+
+  if ((count < 3) || (count > FB_POLY_MAX))
+    return count < 3? 0: -1;
+
+  ymin = ymax = pts[0].y;
+  for (i = 1; i < count; i++) {
+    if (pts[i].y < ymin)
+      ymin = pts[i].y;
+    if (pts[i].y > ymax)
+      ymax = pts[i].y;
+  }
+  if (ymin < c->y0)
+    ymin = c->y0;
+  if (ymax > c->y1)
+    ymax = c->y1;
+
+  for (y = ymin; y < ymax; y++) {
+    /* row center in 16.16, edges are half open in y */
+    yc = ((int64_t)y << 16) + 0x8000;
+    n = 0;
+    for (i = 0, j = count - 1; i < count; j = i++) {
+      const fb_point_t *a = &pts[j], *b = &pts[i];
+      if (((((int64_t)a->y << 16) <= yc) && (((int64_t)b->y << 16) > yc)) ||
+          ((((int64_t)b->y << 16) <= yc) && (((int64_t)a->y << 16) > yc))) {
+        xs[n] = ((int64_t)a->x << 16) +
+                (yc - ((int64_t)a->y << 16)) * (b->x - a->x) / (b->y - a->y);
+        /* insertion sort, crossings per row are few */
+        for (t = n++; (t > 0) && (xs[t - 1] > xs[t]); t--) {
+          int32_t tmp = xs[t];
+          xs[t] = xs[t - 1];
+          xs[t - 1] = tmp;
+        }
+      }
+    }
+    /* pixel is inside when its center is, x0 = ceil(xa - 0.5) */
+    for (i = 0; i + 1 < n; i += 2)
+      fb_draw_hspan(dc, y, (xs[i] - 0x8000 + 0xffff) >> 16,
+                    (xs[i + 1] - 0x8000 + 0xffff) >> 16, color);
+  }
+
+  return 0;
+}
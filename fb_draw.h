@@ -0,0 +1,89 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_draw.h      - span based 2D primitives with clip stack
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_DRAW_H
+#define FB_DRAW_H
+
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_CLIP_DEPTH   8
+/* Vertices of a filled polygon */
+#define FB_POLY_MAX     64
+
+typedef struct fb_point_t {
+  int x, y;
+} fb_point_t;
+
+/*
+  Every primitive is broken into horizontal spans which are clipped
+  against clip[depth] and passed to fb_span_fill(). The top of the
+  stack is always the intersection of all pushed rectangles.
+*/
+typedef struct fb_draw_t {
+  fb_t      *fb;
+  int        depth;
+  fb_rect_t  clip[FB_CLIP_DEPTH + 1];
+} fb_draw_t;
+
+/* Clip starts as the whole framebuffer */
+void fb_draw_init(fb_draw_t *dc, fb_t *fb);
+
+/* Narrows the clip to its intersection with r, -1 when stack is full */
+int fb_draw_clip_push(fb_draw_t *dc, const fb_rect_t *r);
+
+void fb_draw_clip_pop(fb_draw_t *dc);
+
+/* Span [x0, x1) of row y */
+static inline void fb_draw_hspan(fb_draw_t *dc, int y, int x0, int x1,
+                                 uint16_t color)
+{
+  const fb_rect_t *c = &dc->clip[dc->depth];
+
+  if ((y < c->y0) || (y >= c->y1))
+    return;
+  if (x0 < c->x0)
+    x0 = c->x0;
+  if (x1 > c->x1)
+    x1 = c->x1;
+  if (x0 < x1)
+    fb_span_fill(dc->fb->pixels + y * dc->fb->width + x0, x1 - x0, color);
+}
+
+void fb_draw_rect_fill(fb_draw_t *dc, const fb_rect_t *r, uint16_t color);
+
+/* One pixel wide outline inside r */
+void fb_draw_rect(fb_draw_t *dc, const fb_rect_t *r, uint16_t color);
+
+/* Bresenham line including both end points */
+void fb_draw_line(fb_draw_t *dc, int x0, int y0, int x1, int y1, uint16_t color);
+
+/* Midpoint circle outline */
+void fb_draw_circle(fb_draw_t *dc, int cx, int cy, int r, uint16_t color);
+
+void fb_draw_circle_fill(fb_draw_t *dc, int cx, int cy, int r, uint16_t color);
+
+/*
+  Even-odd filled polygon sampled at pixel centers, -1 when count
+  exceeds FB_POLY_MAX
+*/
+int fb_draw_polygon_fill(fb_draw_t *dc, const fb_point_t *pts, int count,
+                         uint16_t color);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_DRAW_H*/
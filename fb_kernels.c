@@ -0,0 +1,277 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_kernels.c      - RGB565 span kernels with NEON and scalar
+                      implementations
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FB_KERNELS_HAVE_NEON 1
+#if defined(__arm__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+#endif
+
+#include "fb_kernels.h"
+
+/* Pixels of both 50% blend inputs without the channel LSBs */
+#define RGB565_HALF_m  0xf7de
+
+static inline uint16_t rgb565_blend(uint16_t d, uint16_t s, int a5)
+{
+  int dr = d >> 11, dg = (d >> 5) & 0x3f, db = d & 0x1f;
+  int sr = s >> 11, sg = (s >> 5) & 0x3f, sb = s & 0x1f;
+
+  dr += ((sr - dr) * a5) >> 5;
+  dg += ((sg - dg) * a5) >> 5;
+  db += ((sb - db) * a5) >> 5;
+
+  return (dr << 11) | (dg << 5) | db;
+}
+
+static void span_fill_scalar(uint16_t *dst, int count, uint16_t color)
+{
+  uint32_t c2 = color | ((uint32_t)color << 16);
+  uint32_t *p;
+
+  if (count <= 0)
+    return;
+
+  /* word stores from a 4 byte aligned address */
+  if ((uintptr_t)dst & 2) {
+    *dst++ = color;
+    count--;
+  }
+  p = (uint32_t *)dst;
+  for (; count >= 8; count -= 8, p += 4) {
+    p[0] = c2;
+    p[1] = c2;
+    p[2] = c2;
+    p[3] = c2;
+  }
+  for (; count >= 2; count -= 2)
+    *p++ = c2;
+  if (count)
+    *(uint16_t *)p = color;
+}
+
+static void span_copy_scalar(uint16_t *dst, const uint16_t *src, int count)
+{
+  if (count > 0)
+    memcpy(dst, src, count * sizeof(*dst));
+}
+
+static void span_copy_key_scalar(uint16_t *dst, const uint16_t *src, int count,
+                                 uint16_t key)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    if (src[i] != key)
+      dst[i] = src[i];
+}
+
+static void span_blend50_scalar(uint16_t *dst, const uint16_t *src, int count)
+{
+  int i;
+
+  /* per channel floor((d + s) / 2) without unpacking */
+  for (i = 0; i < count; i++)
+    dst[i] = (((dst[i] ^ src[i]) & RGB565_HALF_m) >> 1) + (dst[i] & src[i]);
+}
+
+static void span_blend_scalar(uint16_t *dst, const uint16_t *src, int count,
+                              unsigned alpha)
+{
+  int a5 = (alpha > 256? 256: alpha) >> 3;
+  int i;
+
+  for (i = 0; i < count; i++)
+    dst[i] = rgb565_blend(dst[i], src[i], a5);
+}
+
+const fb_kernels_t fb_kernels_scalar = {
+  .name = "scalar",
+  .span_fill = span_fill_scalar,
+  .span_copy = span_copy_scalar,
+  .span_copy_key = span_copy_key_scalar,
+  .span_blend50 = span_blend50_scalar,
+  .span_blend = span_blend_scalar,
+};
+
+#ifdef FB_KERNELS_HAVE_NEON
+
+/*
+  Vector loops handle 8 or 16 pixels at a time, the scalar versions
+  take the unaligned head and the remaining tail.
+*/
+static void span_fill_neon(uint16_t *dst, int count, uint16_t color)
+{
+  uint16x8_t c = vdupq_n_u16(color);
+
+  for (; (count > 0) && ((uintptr_t)dst & 15); count--)
+    *dst++ = color;
+  for (; count >= 32; count -= 32, dst += 32) {
+    vst1q_u16(dst, c);
+    vst1q_u16(dst + 8, c);
+    vst1q_u16(dst + 16, c);
+    vst1q_u16(dst + 24, c);
+  }
+  for (; count >= 8; count -= 8, dst += 8)
+    vst1q_u16(dst, c);
+  span_fill_scalar(dst, count, color);
+}
+
+static void span_copy_neon(uint16_t *dst, const uint16_t *src, int count)
+{
+  for (; count >= 16; count -= 16, dst += 16, src += 16) {
+    uint16x8_t a = vld1q_u16(src);
+    uint16x8_t b = vld1q_u16(src + 8);
+    vst1q_u16(dst, a);
+    vst1q_u16(dst + 8, b);
+  }
+  span_copy_scalar(dst, src, count);
+}
+
+static void span_copy_key_neon(uint16_t *dst, const uint16_t *src, int count,
+                               uint16_t key)
+{
+  uint16x8_t k = vdupq_n_u16(key);
+
+  for (; count >= 8; count -= 8, dst += 8, src += 8) {
+    uint16x8_t s = vld1q_u16(src);
+    uint16x8_t d = vld1q_u16(dst);
+    /* keyed lanes keep the destination */
+    vst1q_u16(dst, vbslq_u16(vceqq_u16(s, k), d, s));
+  }
+  span_copy_key_scalar(dst, src, count, key);
+}
+
+static void span_blend50_neon(uint16_t *dst, const uint16_t *src, int count)
+{
+  uint16x8_t half = vdupq_n_u16(RGB565_HALF_m);
+
+  for (; count >= 8; count -= 8, dst += 8, src += 8) {
+    uint16x8_t s = vld1q_u16(src);
+    uint16x8_t d = vld1q_u16(dst);
+    uint16x8_t x = vshrq_n_u16(vandq_u16(veorq_u16(d, s), half), 1);
+    vst1q_u16(dst, vaddq_u16(x, vandq_u16(d, s)));
+  }
+  span_blend50_scalar(dst, src, count);
+}
+
+static void span_blend_neon(uint16_t *dst, const uint16_t *src, int count,
+                            unsigned alpha)
+{
+  int a5 = (alpha > 256? 256: alpha) >> 3;
+  int16x8_t a = vdupq_n_s16(a5);
+  uint16x8_t m6 = vdupq_n_u16(0x3f);
+  uint16x8_t m5 = vdupq_n_u16(0x1f);
+
+  for (; count >= 8; count -= 8, dst += 8, src += 8) {
+    uint16x8_t s = vld1q_u16(src);
+    uint16x8_t d = vld1q_u16(dst);
+    int16x8_t dr = vreinterpretq_s16_u16(vshrq_n_u16(d, 11));
+    int16x8_t dg = vreinterpretq_s16_u16(vandq_u16(vshrq_n_u16(d, 5), m6));
+    int16x8_t db = vreinterpretq_s16_u16(vandq_u16(d, m5));
+    int16x8_t sr = vreinterpretq_s16_u16(vshrq_n_u16(s, 11));
+    int16x8_t sg = vreinterpretq_s16_u16(vandq_u16(vshrq_n_u16(s, 5), m6));
+    int16x8_t sb = vreinterpretq_s16_u16(vandq_u16(s, m5));
+    uint16x8_t r;
+
+    dr = vaddq_s16(dr, vshrq_n_s16(vmulq_s16(vsubq_s16(sr, dr), a), 5));
+    dg = vaddq_s16(dg, vshrq_n_s16(vmulq_s16(vsubq_s16(sg, dg), a), 5));
+    db = vaddq_s16(db, vshrq_n_s16(vmulq_s16(vsubq_s16(sb, db), a), 5));
+
+    r = vshlq_n_u16(vreinterpretq_u16_s16(dr), 11);
+    r = vorrq_u16(r, vshlq_n_u16(vreinterpretq_u16_s16(dg), 5));
+    r = vorrq_u16(r, vreinterpretq_u16_s16(db));
+    vst1q_u16(dst, r);
+  }
+  span_blend_scalar(dst, src, count, alpha);
+}
+
+static const fb_kernels_t fb_kernels_neon_impl = {
+  .name = "neon",
+  .span_fill = span_fill_neon,
+  .span_copy = span_copy_neon,
+  .span_copy_key = span_copy_key_neon,
+  .span_blend50 = span_blend50_neon,
+  .span_blend = span_blend_neon,
+};
+
+const fb_kernels_t *const fb_kernels_neon = &fb_kernels_neon_impl;
+
+static int fb_kernels_cpu_has_neon(void)
+{
+#if defined(__arm__)
+  return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+  return 1;
+#endif
+}
+
+#else /*FB_KERNELS_HAVE_NEON*/
+
+const fb_kernels_t *const fb_kernels_neon = NULL;
+
+static int fb_kernels_cpu_has_neon(void)
+{
+  return 0;
+}
+
+#endif /*FB_KERNELS_HAVE_NEON*/
+
+/* compile time choice, fb_kernels_select() may check the CPU */
+#ifdef FB_KERNELS_HAVE_NEON
+fb_kernels_t fb_kern = {
+  .name = "neon",
+  .span_fill = span_fill_neon,
+  .span_copy = span_copy_neon,
+  .span_copy_key = span_copy_key_neon,
+  .span_blend50 = span_blend50_neon,
+  .span_blend = span_blend_neon,
+};
+#else
+fb_kernels_t fb_kern = {
+  .name = "scalar",
+  .span_fill = span_fill_scalar,
+  .span_copy = span_copy_scalar,
+  .span_copy_key = span_copy_key_scalar,
+  .span_blend50 = span_blend50_scalar,
+  .span_blend = span_blend_scalar,
+};
+#endif
+
+int fb_kernels_select(int impl)
+{
+  switch (impl) {
+    case FB_KERNELS_AUTO:
+      fb_kern = (fb_kernels_neon && fb_kernels_cpu_has_neon())?
+                *fb_kernels_neon: fb_kernels_scalar;
+      return 0;
+    case FB_KERNELS_SCALAR:
+      fb_kern = fb_kernels_scalar;
+      return 0;
+    case FB_KERNELS_NEON:
+      if (!fb_kernels_neon || !fb_kernels_cpu_has_neon())
+        return -1;
+      fb_kern = *fb_kernels_neon;
+      return 0;
+  }
+
+  return -1;
+}
@@ -0,0 +1,60 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_kernels.h      - RGB565 span kernels with NEON and scalar
+                      implementations
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_KERNELS_H
+#define FB_KERNELS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_KERNELS_AUTO    0
+#define FB_KERNELS_SCALAR  1
+#define FB_KERNELS_NEON    2
+
+/*
+  Span operations over count pixels. Blend results are computed per
+  color channel as d + ((s - d) * a >> 5) with 5-bit alpha, both
+  implementations produce identical pixels.
+*/
+typedef struct fb_kernels_t {
+  const char *name;
+  void (*span_fill)(uint16_t *dst, int count, uint16_t color);
+  void (*span_copy)(uint16_t *dst, const uint16_t *src, int count);
+  /* src pixels equal to key are left out */
+  void (*span_copy_key)(uint16_t *dst, const uint16_t *src, int count,
+                        uint16_t key);
+  void (*span_blend50)(uint16_t *dst, const uint16_t *src, int count);
+  /* alpha 0 keeps dst, 256 gives src */
+  void (*span_blend)(uint16_t *dst, const uint16_t *src, int count,
+                     unsigned alpha);
+} fb_kernels_t;
+
+/* Active implementation, NEON when compiled in */
+extern fb_kernels_t fb_kern;
+
+extern const fb_kernels_t fb_kernels_scalar;
+/* NULL when not compiled in */
+extern const fb_kernels_t *const fb_kernels_neon;
+
+/*
+  FB_KERNELS_AUTO takes NEON when compiled in and reported by the
+  CPU, returns -1 when the requested implementation is not available
+*/
+int fb_kernels_select(int impl);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_KERNELS_H*/
@@ -0,0 +1,136 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_pacer.c      - frame pacing of LCD transfers to display refresh
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "fb_pacer.h"
+
+static inline int64_t ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+  return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000 + (a->tv_nsec - b->tv_nsec);
+}
+
+static inline void ts_add_ns(struct timespec *ts, int64_t ns)
+{
+  ns += ts->tv_nsec;
+  ts->tv_sec += ns / 1000000000;
+  ts->tv_nsec = ns % 1000000000;
+}
+
+static int fb_pacer_sim_vsync(void *context, struct timespec *vsync)
+{
+  fb_pacer_t *pacer = (fb_pacer_t *)context;
+  struct timespec now;
+  int64_t late;
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &pacer->next, NULL) == EINTR)
+    ;
+
+  /* after idle time or an overrun continue from the latest slot */
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  late = ts_diff_ns(&now, &pacer->next);
+  if (late >= pacer->period_ns)
+    ts_add_ns(&pacer->next, (late / pacer->period_ns) * pacer->period_ns);
+
+  *vsync = pacer->next;
+  ts_add_ns(&pacer->next, pacer->period_ns);
+
+  return 0;
+}
+
+void fb_pacer_init(fb_pacer_t *pacer, int refresh_hz)
+{
+  memset(pacer, 0, sizeof(*pacer));
+  pacer->period_ns = 1000000000L / (refresh_hz > 0? refresh_hz: 60);
+  pacer->latency_min_ns = -1;
+  clock_gettime(CLOCK_MONOTONIC, &pacer->next);
+  pacer->last_vsync = pacer->next;
+  fb_pacer_set_vsync(pacer, NULL, NULL);
+}
+
+void fb_pacer_set_vsync(fb_pacer_t *pacer, fb_vsync_wait_t *wait, void *context)
+{
+  if (wait == NULL) {
+    wait = fb_pacer_sim_vsync;
+    context = pacer;
+  }
+  pacer->vsync_wait = wait;
+  pacer->vsync_context = context;
+}
+
+int fb_pacer_wait(fb_pacer_t *pacer, struct timespec *vsync)
+{
+  int ret;
+
+  ret = pacer->vsync_wait(pacer->vsync_context, vsync);
+  pacer->last_vsync = *vsync;
+
+  return ret;
+}
+
+void fb_pacer_frame_done(fb_pacer_t *pacer, const struct timespec *submitted)
+{
+  struct timespec now;
+  int64_t lat;
+  int64_t overrun;
+  unsigned long seq;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  lat = ts_diff_ns(&now, submitted);
+
+  /* transfer still running at the following sync shows torn frames */
+  overrun = ts_diff_ns(&now, &pacer->last_vsync) - pacer->period_ns;
+  if (overrun > 0)
+    __atomic_add_fetch(&pacer->missed, overrun / pacer->period_ns + 1,
+                       __ATOMIC_RELAXED);
+
+  /*
+    Single writer sequence lock, atomic stores also keep the 64-bit
+    values whole on 32-bit ARM
+  */
+  seq = pacer->stats_seq;
+  __atomic_store_n(&pacer->stats_seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  if ((pacer->latency_min_ns < 0) || (lat < pacer->latency_min_ns))
+    __atomic_store_n(&pacer->latency_min_ns, lat, __ATOMIC_RELAXED);
+  if (lat > pacer->latency_max_ns)
+    __atomic_store_n(&pacer->latency_max_ns, lat, __ATOMIC_RELAXED);
+  __atomic_store_n(&pacer->latency_sum_ns, pacer->latency_sum_ns + lat, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pacer->frames, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&pacer->stats_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void fb_pacer_get_stats(fb_pacer_t *pacer, fb_pacer_stats_t *stats)
+{
+  int64_t min_ns, max_ns, sum_ns;
+  unsigned long frames, seq;
+
+  /* retried while the flush thread updates, the values belong together */
+  do {
+    seq = __atomic_load_n(&pacer->stats_seq, __ATOMIC_ACQUIRE);
+    frames = __atomic_load_n(&pacer->frames, __ATOMIC_RELAXED);
+    sum_ns = __atomic_load_n(&pacer->latency_sum_ns, __ATOMIC_RELAXED);
+    min_ns = __atomic_load_n(&pacer->latency_min_ns, __ATOMIC_RELAXED);
+    max_ns = __atomic_load_n(&pacer->latency_max_ns, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || (seq != __atomic_load_n(&pacer->stats_seq, __ATOMIC_RELAXED)));
+
+  stats->frames = frames;
+  stats->coalesced = __atomic_load_n(&pacer->coalesced, __ATOMIC_RELAXED);
+  stats->missed = __atomic_load_n(&pacer->missed, __ATOMIC_RELAXED);
+  stats->latency_min_us = min_ns < 0? 0: min_ns / 1000;
+  stats->latency_max_us = max_ns / 1000;
+  stats->latency_avg_us = frames? (long)(sum_ns / frames / 1000): 0;
+}
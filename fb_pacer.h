@@ -0,0 +1,71 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_pacer.h      - frame pacing of LCD transfers to display refresh
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_PACER_H
+#define FB_PACER_H
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Blocks until the next vertical sync and stores its time */
+typedef int fb_vsync_wait_t(void *context, struct timespec *vsync);
+
+/*
+  The HX8357-C tearing effect output is enabled by parlcd_hx8357_init()
+  but the signal is not visible in the MZ_APO register map. Without
+  a vsync source the pacer runs from CLOCK_MONOTONIC at the target
+  refresh, which is also what the host simulation uses.
+*/
+typedef struct fb_pacer_t {
+  long             period_ns;
+  struct timespec  next;
+  struct timespec  last_vsync;
+  fb_vsync_wait_t *vsync_wait;
+  void            *vsync_context;
+  unsigned long    frames;        /* transfers done */
+  unsigned long    coalesced;     /* submissions replaced by newer ones */
+  unsigned long    missed;        /* refresh periods lost to long transfers */
+  /* written by the flush thread only, odd stats_seq while updating */
+  unsigned long    stats_seq;
+  int64_t          latency_min_ns;
+  int64_t          latency_max_ns;
+  int64_t          latency_sum_ns;
+} fb_pacer_t;
+
+typedef struct fb_pacer_stats_t {
+  unsigned long frames;
+  unsigned long coalesced;
+  unsigned long missed;
+  long          latency_min_us;
+  long          latency_avg_us;
+  long          latency_max_us;
+} fb_pacer_stats_t;
+
+void fb_pacer_init(fb_pacer_t *pacer, int refresh_hz);
+
+/* Replaces the timer based simulated vsync by an external source */
+void fb_pacer_set_vsync(fb_pacer_t *pacer, fb_vsync_wait_t *wait, void *context);
+
+int fb_pacer_wait(fb_pacer_t *pacer, struct timespec *vsync);
+
+/* Accounts transfer of a frame submitted at given time, now visible */
+void fb_pacer_frame_done(fb_pacer_t *pacer, const struct timespec *submitted);
+
+void fb_pacer_get_stats(fb_pacer_t *pacer, fb_pacer_stats_t *stats);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_PACER_H*/
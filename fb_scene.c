@@ -0,0 +1,353 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_scene.c      - retained display list repainted only where
+                    its nodes changed
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fb_scene.h"
+
+static inline int rect_overlap(const fb_rect_t *a, const fb_rect_t *b)
+{
+  return (a->x0 < b->x1) && (b->x0 < a->x1) &&
+         (a->y0 < b->y1) && (b->y0 < a->y1);
+}
+
+static inline int rect_contains(const fb_rect_t *a, const fb_rect_t *b)
+{
+  return (a->x0 <= b->x0) && (a->y0 <= b->y0) &&
+         (a->x1 >= b->x1) && (a->y1 >= b->y1);
+}
+
+/* Records the node area for repaint, hidden nodes cover nothing */
+static void fb_scene_dirty(fb_scene_t *sc, fb_node_t *node)
+{
+  if (!(node->flags & FB_NODE_VISIBLE_m))
+    return;
+  node->flags |= FB_NODE_DIRTY_m;
+  fb_damage_add_rect(&sc->dmg, &node->bounds);
+}
+
+int fb_scene_init(fb_scene_t *sc, fb_t *fb, int max_nodes, uint16_t bg)
+{
+  int i;
+
+  sc->pool = calloc(max_nodes, sizeof(fb_node_t));
+  if (sc->pool == NULL)
+    return -1;
+
+  sc->fb = fb;
+  sc->bg = bg;
+  sc->pool_size = max_nodes;
+  sc->head = NULL;
+  sc->tail = NULL;
+  sc->free = NULL;
+  for (i = max_nodes; i--; ) {
+    sc->pool[i].next = sc->free;
+    sc->free = &sc->pool[i];
+  }
+
+  fb_damage_clear(&sc->dmg);
+  fb_damage_add(&sc->dmg, 0, 0, fb->width, fb->height);
+
+  return 0;
+}
+
+void fb_scene_free(fb_scene_t *sc)
+{
+  free(sc->pool);
+  sc->pool = NULL;
+  sc->free = NULL;
+  sc->head = NULL;
+  sc->tail = NULL;
+}
+
+/* Takes a node from the pool and puts it on top */
+static fb_node_t *fb_scene_alloc(fb_scene_t *sc, int type)
+{
+  fb_node_t *node = sc->free;
+
+  if (node == NULL)
+    return NULL;
+  sc->free = node->next;
+
+  memset(node, 0, sizeof(*node));
+  node->type = type;
+  node->flags = FB_NODE_USED_m | FB_NODE_VISIBLE_m;
+  node->prev = sc->tail;
+  if (sc->tail != NULL)
+    sc->tail->next = node;
+  else
+    sc->head = node;
+  sc->tail = node;
+
+  return node;
+}
+
+static void fb_scene_unlink(fb_scene_t *sc, fb_node_t *node)
+{
+  if (node->prev != NULL)
+    node->prev->next = node->next;
+  else
+    sc->head = node->next;
+  if (node->next != NULL)
+    node->next->prev = node->prev;
+  else
+    sc->tail = node->prev;
+  node->prev = NULL;
+  node->next = NULL;
+}
+
+fb_node_t *fb_scene_rect(fb_scene_t *sc, const fb_rect_t *r, uint16_t color)
+{
+  fb_node_t *node = fb_scene_alloc(sc, FB_NODE_RECT);
+
+  if (node == NULL)
+    return NULL;
+  node->bounds = *r;
+  node->u.rect.color = color;
+  fb_scene_dirty(sc, node);
+
+  return node;
+}
+
+static void fb_scene_text_bounds(fb_node_t *node, int x, int y)
+{
+  const font_descriptor_t *font = node->u.text.atlas->font;
+
+  node->bounds.x0 = x;
+  node->bounds.y0 = y;
+  node->bounds.x1 = x + font_text_width(font, node->u.text.str);
+  node->bounds.y1 = y + font->height;
+}
+
+fb_node_t *fb_scene_text(fb_scene_t *sc, const font_atlas_t *atlas,
+                         int x, int y, const char *str)
+{
+  fb_node_t *node = fb_scene_alloc(sc, FB_NODE_TEXT);
+
+  if (node == NULL)
+    return NULL;
+  node->u.text.atlas = atlas;
+  strncpy(node->u.text.str, str, FB_NODE_TEXT_MAX - 1);
+  fb_scene_text_bounds(node, x, y);
+  fb_scene_dirty(sc, node);
+
+  return node;
+}
+
+fb_node_t *fb_scene_image(fb_scene_t *sc, const asset_image_t *img, int x, int y)
+{
+  fb_node_t *node = fb_scene_alloc(sc, FB_NODE_IMAGE);
+  fb_rect_t r = {x, y, x + img->width, y + img->height};
+
+  if (node == NULL)
+    return NULL;
+  node->bounds = r;
+  node->u.image = *img;
+  fb_scene_dirty(sc, node);
+
+  return node;
+}
+
+fb_node_t *fb_scene_sprite(fb_scene_t *sc, const asset_sprite_t *spr, int x, int y)
+{
+  fb_node_t *node = fb_scene_alloc(sc, FB_NODE_SPRITE);
+  fb_rect_t r = {x, y, x + spr->width, y + spr->height};
+
+  if (node == NULL)
+    return NULL;
+  node->bounds = r;
+  node->u.sprite = *spr;
+  fb_scene_dirty(sc, node);
+
+  return node;
+}
+
+fb_node_t *fb_scene_widget(fb_scene_t *sc, const fb_rect_t *r,
+                           fb_node_draw_t *draw, void *ctx)
+{
+  fb_node_t *node = fb_scene_alloc(sc, FB_NODE_WIDGET);
+
+  if (node == NULL)
+    return NULL;
+  node->bounds = *r;
+  node->u.widget.draw = draw;
+  node->u.widget.ctx = ctx;
+  fb_scene_dirty(sc, node);
+
+  return node;
+}
+
+void fb_scene_remove(fb_scene_t *sc, fb_node_t *node)
+{
+  fb_scene_dirty(sc, node);
+  fb_scene_unlink(sc, node);
+  node->flags = 0;
+  node->next = sc->free;
+  sc->free = node;
+}
+
+static void fb_scene_update_bounds(fb_scene_t *sc, fb_node_t *node,
+                                   const fb_rect_t *r)
+{
+  if (!memcmp(&node->bounds, r, sizeof(*r)))
+    return;
+  fb_scene_dirty(sc, node);
+  node->bounds = *r;
+  fb_scene_dirty(sc, node);
+}
+
+void fb_scene_move(fb_scene_t *sc, fb_node_t *node, int x, int y)
+{
+  fb_rect_t r;
+
+  r.x0 = x;
+  r.y0 = y;
+  r.x1 = x + node->bounds.x1 - node->bounds.x0;
+  r.y1 = y + node->bounds.y1 - node->bounds.y0;
+  fb_scene_update_bounds(sc, node, &r);
+}
+
+void fb_scene_set_bounds(fb_scene_t *sc, fb_node_t *node, const fb_rect_t *r)
+{
+  if (node->type == FB_NODE_RECT || node->type == FB_NODE_WIDGET)
+    fb_scene_update_bounds(sc, node, r);
+  else
+    fb_scene_move(sc, node, r->x0, r->y0);
+}
+
+void fb_scene_set_color(fb_scene_t *sc, fb_node_t *node, uint16_t color)
+{
+  if (node->type != FB_NODE_RECT || node->u.rect.color == color)
+    return;
+  node->u.rect.color = color;
+  fb_scene_dirty(sc, node);
+}
+
+void fb_scene_set_text(fb_scene_t *sc, fb_node_t *node, const char *str)
+{
+  if (node->type != FB_NODE_TEXT ||
+      !strncmp(node->u.text.str, str, FB_NODE_TEXT_MAX - 1))
+    return;
+  fb_scene_dirty(sc, node);
+  strncpy(node->u.text.str, str, FB_NODE_TEXT_MAX - 1);
+  fb_scene_text_bounds(node, node->bounds.x0, node->bounds.y0);
+  fb_scene_dirty(sc, node);
+}
+
+void fb_scene_set_visible(fb_scene_t *sc, fb_node_t *node, int visible)
+{
+  if (!(node->flags & FB_NODE_VISIBLE_m) == !visible)
+    return;
+  /* dirty while visible, before hiding or after showing */
+  fb_scene_dirty(sc, node);
+  node->flags ^= FB_NODE_VISIBLE_m;
+  fb_scene_dirty(sc, node);
+}
+
+void fb_scene_raise(fb_scene_t *sc, fb_node_t *node)
+{
+  if (sc->tail == node)
+    return;
+  fb_scene_unlink(sc, node);
+  node->prev = sc->tail;
+  sc->tail->next = node;
+  sc->tail = node;
+  fb_scene_dirty(sc, node);
+}
+
+void fb_scene_invalidate(fb_scene_t *sc, fb_node_t *node)
+{
+  fb_scene_dirty(sc, node);
+}
+
+/* Rectangles, images and text cells cover their bounds completely */
+static inline int fb_node_opaque(const fb_node_t *node)
+{
+  return node->type == FB_NODE_RECT || node->type == FB_NODE_IMAGE ||
+         node->type == FB_NODE_TEXT;
+}
+
+static void fb_scene_paint(fb_scene_t *sc, fb_draw_t *dc, const fb_node_t *node)
+{
+  const fb_rect_t *clip = &dc->clip[dc->depth];
+
+  switch (node->type) {
+    case FB_NODE_RECT:
+      fb_draw_rect_fill(dc, &node->bounds, node->u.rect.color);
+      break;
+    case FB_NODE_TEXT:
+      font_atlas_draw_text_clip(sc->fb, node->u.text.atlas, node->bounds.x0,
+                                node->bounds.y0, node->u.text.str, clip);
+      break;
+    case FB_NODE_IMAGE:
+      asset_image_blit_clip(sc->fb, &node->u.image, node->bounds.x0,
+                            node->bounds.y0, clip);
+      break;
+    case FB_NODE_SPRITE:
+      asset_sprite_blit_clip(sc->fb, &node->u.sprite, node->bounds.x0,
+                             node->bounds.y0, clip);
+      break;
+    case FB_NODE_WIDGET:
+      if (fb_draw_clip_push(dc, &node->bounds))
+        break;
+      node->u.widget.draw(dc, node);
+      fb_draw_clip_pop(dc);
+      break;
+  }
+}
+
+long fb_scene_render(fb_scene_t *sc)
+{
+  fb_draw_t dc;
+  fb_node_t *node, *bottom;
+  const fb_rect_t *r;
+  int i;
+
+  fb_draw_init(&dc, sc->fb);
+
+  for (i = 0; i < sc->dmg.count; i++) {
+    r = &sc->dmg.rect[i];
+    if (fb_draw_clip_push(&dc, r))
+      break;
+
+    /* nothing below the topmost opaque node covering the area shows */
+    for (bottom = sc->tail; bottom != NULL; bottom = bottom->prev)
+      if ((bottom->flags & FB_NODE_VISIBLE_m) && fb_node_opaque(bottom) &&
+          rect_contains(&bottom->bounds, r))
+        break;
+
+    if (bottom == NULL) {
+      fb_draw_rect_fill(&dc, r, sc->bg);
+      bottom = sc->head;
+    }
+
+    for (node = bottom; node != NULL; node = node->next)
+      if ((node->flags & FB_NODE_VISIBLE_m) && rect_overlap(&node->bounds, r))
+        fb_scene_paint(sc, &dc, node);
+
+    fb_draw_clip_pop(&dc);
+  }
+
+  for (node = sc->head; node != NULL; node = node->next)
+    node->flags &= ~FB_NODE_DIRTY_m;
+
+  return fb_damage_area(&sc->dmg);
+}
+
+long fb_scene_flush(fb_scene_t *sc, unsigned char *parlcd_mem_base)
+{
+  long n = fb_scene_render(sc);
+
+  fb_flush_damage(sc->fb, &sc->dmg, parlcd_mem_base);
+
+  return n;
+}
@@ -0,0 +1,134 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_scene.h      - retained display list repainted only where
+                    its nodes changed
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_SCENE_H
+#define FB_SCENE_H
+
+#include <stdint.h>
+
+#include "asset_pack.h"
+#include "fb_damage.h"
+#include "fb_draw.h"
+#include "font_atlas.h"
+#include "framebuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_NODE_RECT    1
+#define FB_NODE_TEXT    2
+#define FB_NODE_IMAGE   3
+#define FB_NODE_SPRITE  4
+#define FB_NODE_WIDGET  5
+
+#define FB_NODE_USED_m     0x01
+#define FB_NODE_VISIBLE_m  0x02
+#define FB_NODE_DIRTY_m    0x04
+
+/* Text is kept in the node, longer strings are cut */
+#define FB_NODE_TEXT_MAX   40
+
+typedef struct fb_node_t fb_node_t;
+
+/* Widget painter, dc clip is already narrowed to the repainted area */
+typedef void fb_node_draw_t(fb_draw_t *dc, const fb_node_t *node);
+
+struct fb_node_t {
+  int        type;
+  int        flags;
+  fb_rect_t  bounds;
+  fb_node_t *prev;      /* painting order, later nodes are on top */
+  fb_node_t *next;
+  union {
+    struct {
+      uint16_t color;
+    } rect;
+    struct {
+      const font_atlas_t *atlas;
+      char                str[FB_NODE_TEXT_MAX];
+    } text;
+    asset_image_t  image;
+    asset_sprite_t sprite;
+    struct {
+      fb_node_draw_t *draw;
+      void           *ctx;
+    } widget;
+  } u;
+};
+
+/*
+  Nodes come from a pool allocated once by fb_scene_init, areas left
+  by changed nodes are painted with bg before the nodes covering them.
+*/
+typedef struct fb_scene_t {
+  fb_t        *fb;
+  uint16_t     bg;
+  fb_node_t   *pool;
+  int          pool_size;
+  fb_node_t   *free;
+  fb_node_t   *head;
+  fb_node_t   *tail;
+  fb_damage_t  dmg;
+} fb_scene_t;
+
+/* Whole framebuffer starts dirty */
+int fb_scene_init(fb_scene_t *sc, fb_t *fb, int max_nodes, uint16_t bg);
+
+void fb_scene_free(fb_scene_t *sc);
+
+/* Node constructors return NULL when the pool is exhausted */
+fb_node_t *fb_scene_rect(fb_scene_t *sc, const fb_rect_t *r, uint16_t color);
+
+fb_node_t *fb_scene_text(fb_scene_t *sc, const font_atlas_t *atlas,
+                         int x, int y, const char *str);
+
+fb_node_t *fb_scene_image(fb_scene_t *sc, const asset_image_t *img, int x, int y);
+
+fb_node_t *fb_scene_sprite(fb_scene_t *sc, const asset_sprite_t *spr, int x, int y);
+
+fb_node_t *fb_scene_widget(fb_scene_t *sc, const fb_rect_t *r,
+                           fb_node_draw_t *draw, void *ctx);
+
+void fb_scene_remove(fb_scene_t *sc, fb_node_t *node);
+
+/* Setters dirty the old and the new bounds, unchanged values nothing */
+void fb_scene_move(fb_scene_t *sc, fb_node_t *node, int x, int y);
+
+/* Text, image and sprite keep the size of their content and only move */
+void fb_scene_set_bounds(fb_scene_t *sc, fb_node_t *node, const fb_rect_t *r);
+
+void fb_scene_set_color(fb_scene_t *sc, fb_node_t *node, uint16_t color);
+
+void fb_scene_set_text(fb_scene_t *sc, fb_node_t *node, const char *str);
+
+void fb_scene_set_visible(fb_scene_t *sc, fb_node_t *node, int visible);
+
+/* Moves the node on top of all others */
+void fb_scene_raise(fb_scene_t *sc, fb_node_t *node);
+
+/* Widget state changed, repaints its bounds */
+void fb_scene_invalidate(fb_scene_t *sc, fb_node_t *node);
+
+/*
+  Repaints the dirty areas into the framebuffer, returns their pixel
+  count. The areas stay in sc->dmg until passed to fb_flush_damage.
+*/
+long fb_scene_render(fb_scene_t *sc);
+
+/* Renders and sends the repainted areas, one address window each */
+long fb_scene_flush(fb_scene_t *sc, unsigned char *parlcd_mem_base);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_SCENE_H*/
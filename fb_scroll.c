@@ -0,0 +1,128 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_scroll.c      - log view scrolled by the LCD controller, only
+                     newly exposed lines are transferred
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#include "fb_scroll.h"
+
+/* Rectangle covering logical lines a..b-1 across the whole framebuffer */
+static void fb_scroll_lines_rect(const fb_scroll_t *fs, int a, int b, fb_rect_t *r)
+{
+  if (fs->sc.axis == PARLCD_SCROLL_X) {
+    r->x0 = a;
+    r->x1 = b;
+    r->y0 = 0;
+    r->y1 = fs->fb->height;
+  } else {
+    r->x0 = 0;
+    r->x1 = fs->fb->width;
+    r->y0 = a;
+    r->y1 = b;
+  }
+}
+
+int fb_scroll_init(fb_scroll_t *fs, fb_t *fb, unsigned char *parlcd_mem_base,
+                   uint8_t madctl, int start, int len)
+{
+  int size = (madctl & PARLCD_MADCTL_MV_m)? fb->width: fb->height;
+
+  if (start < 0 || len <= 0 || start + len > size)
+    return -1;
+
+  fs->fb = fb;
+
+  return parlcd_scroll_init(parlcd_mem_base, &fs->sc, madctl, start, len);
+}
+
+int fb_scroll_next(const fb_scroll_t *fs, int lines, fb_rect_t r[2])
+{
+  const parlcd_scroll_t *sc = &fs->sc;
+  int first, tail;
+
+  if (lines > sc->len)
+    lines = sc->len;
+
+  /* lines leaving at the area start come back at its end */
+  first = parlcd_scroll_mem_line(sc, 0);
+  tail = sc->start + sc->len - first;
+
+  if (lines <= tail) {
+    fb_scroll_lines_rect(fs, first, first + lines, &r[0]);
+    return 1;
+  }
+
+  fb_scroll_lines_rect(fs, first, first + tail, &r[0]);
+  fb_scroll_lines_rect(fs, sc->start, sc->start + lines - tail, &r[1]);
+
+  return 2;
+}
+
+void fb_scroll_push(fb_scroll_t *fs, int lines, unsigned char *parlcd_mem_base)
+{
+  fb_rect_t r[2];
+  int n, i;
+
+  if (lines > fs->sc.len)
+    lines = fs->sc.len;
+
+  n = fb_scroll_next(fs, lines, r);
+  for (i = 0; i < n; i++)
+    fb_flush_rect(fs->fb, &r[i], parlcd_mem_base);
+
+  parlcd_scroll_by(parlcd_mem_base, &fs->sc, lines);
+}
+
+/* Reverses order of logical lines a..b-1 in the framebuffer */
+static void fb_scroll_reverse(fb_scroll_t *fs, int a, int b)
+{
+  fb_t *fb = fs->fb;
+  uint16_t *pa, *pb, t;
+  int i;
+
+  for (b--; a < b; a++, b--) {
+    if (fs->sc.axis == PARLCD_SCROLL_X) {
+      pa = fb->pixels + a;
+      pb = fb->pixels + b;
+      for (i = 0; i < fb->height; i++, pa += fb->width, pb += fb->width) {
+        t = *pa;
+        *pa = *pb;
+        *pb = t;
+      }
+    } else {
+      pa = fb->pixels + a * fb->width;
+      pb = fb->pixels + b * fb->width;
+      for (i = 0; i < fb->width; i++) {
+        t = pa[i];
+        pa[i] = pb[i];
+        pb[i] = t;
+      }
+    }
+  }
+}
+
+void fb_scroll_fini(fb_scroll_t *fs, unsigned char *parlcd_mem_base)
+{
+  parlcd_scroll_t *sc = &fs->sc;
+  int start = sc->start;
+  int end = sc->start + sc->len;
+  int mid = start + sc->offset;
+  fb_rect_t r;
+
+  /* rotate the area left by offset lines */
+  if (sc->offset) {
+    fb_scroll_reverse(fs, start, mid);
+    fb_scroll_reverse(fs, mid, end);
+    fb_scroll_reverse(fs, start, end);
+  }
+
+  parlcd_scroll_off(parlcd_mem_base, sc);
+
+  fb_scroll_lines_rect(fs, start, end, &r);
+  fb_flush_rect(fs->fb, &r, parlcd_mem_base);
+}
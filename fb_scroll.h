@@ -0,0 +1,59 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  fb_scroll.h      - log view scrolled by the LCD controller, only
+                     newly exposed lines are transferred
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FB_SCROLL_H
+#define FB_SCROLL_H
+
+#include "framebuffer.h"
+#include "mzapo_parlcd.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  The framebuffer area keeps the panel memory order, line i of the
+  view lives at parlcd_scroll_mem_line(&sc, i). Lines run along
+  sc.axis, x for the landscape controllers.
+
+  With MADCTL 0xE8 or 0x28 (MV set) the controller scrolls along the
+  panel's native columns, so a log line is a vertical column of the
+  framebuffer spanning its full height, not a text row. Drawing into
+  the rectangles from fb_scroll_next must be clipped to them.
+*/
+typedef struct fb_scroll_t {
+  fb_t           *fb;
+  parlcd_scroll_t sc;
+} fb_scroll_t;
+
+/* Starts scrolling lines start..start+len-1 for the given MADCTL */
+int fb_scroll_init(fb_scroll_t *fs, fb_t *fb, unsigned char *parlcd_mem_base,
+                   uint8_t madctl, int start, int len);
+
+/*
+  Fills r with the framebuffer rectangles the next lines are drawn to,
+  they appear at the area end after fb_scroll_push. Returns 2 when the
+  lines wrap around the area end, keep len a multiple of lines to
+  always get one.
+*/
+int fb_scroll_next(const fb_scroll_t *fs, int lines, fb_rect_t r[2]);
+
+/* Transfers the next lines and scrolls them into view */
+void fb_scroll_push(fb_scroll_t *fs, int lines, unsigned char *parlcd_mem_base);
+
+/* Restores display order in the framebuffer and leaves scrolling */
+void fb_scroll_fini(fb_scroll_t *fs, unsigned char *parlcd_mem_base);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FB_SCROLL_H*/
@@ -0,0 +1,123 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  font_atlas.c      - text rendering from pre-expanded glyph atlas
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "font_atlas.h"
+
+int font_atlas_init(font_atlas_t *atlas, const font_descriptor_t *font,
+                    uint16_t fg, uint16_t bg)
+{
+  int height = font->height;
+  int idx, row, col;
+
+  atlas->font = font;
+  atlas->fg = fg;
+  atlas->bg = bg;
+  atlas->stride = font->maxwidth;
+  atlas->spans = malloc((size_t)font->size * height * atlas->stride * sizeof(uint16_t));
+  atlas->width = malloc(font->size);
+
+  if ((atlas->spans == NULL) || (atlas->width == NULL)) {
+    font_atlas_free(atlas);
+    return -1;
+  }
+
+  for (idx = 0; idx < font->size; idx++) {
+    const font_bits_t *bits;
+    uint16_t *span = atlas->spans + (size_t)idx * height * atlas->stride;
+
+    bits = font_glyph_bits(font, idx);
+    atlas->width[idx] = font_glyph_width(font, idx);
+
+    /* bitmap rows are left aligned, bit 15 is the leftmost pixel */
+    for (row = 0; row < height; row++, span += atlas->stride)
+      for (col = 0; col < atlas->stride; col++)
+        span[col] = (bits[row] & (0x8000 >> col))? fg: bg;
+  }
+
+  return 0;
+}
+
+void font_atlas_free(font_atlas_t *atlas)
+{
+  free(atlas->spans);
+  free(atlas->width);
+  atlas->spans = NULL;
+  atlas->width = NULL;
+}
+
+int font_atlas_draw_char_clip(fb_t *fb, const font_atlas_t *atlas,
+                              int x, int y, int ch, const fb_rect_t *clip)
+{
+  int idx = font_glyph_index(atlas->font, (unsigned char)ch);
+  int height = atlas->font->height;
+  const uint16_t *span;
+  uint16_t *dst;
+  int w, cx0, cx1, cy0, cy1;
+  int x0, y0, x1, y1;
+
+  if (idx < 0)
+    return 0;
+
+  w = atlas->width[idx];
+  span = atlas->spans + (size_t)idx * height * atlas->stride;
+
+  /* clip the glyph cell against the clip rectangle and the framebuffer */
+  x0 = clip->x0 > 0? clip->x0: 0;
+  y0 = clip->y0 > 0? clip->y0: 0;
+  x1 = clip->x1 < fb->width? clip->x1: fb->width;
+  y1 = clip->y1 < fb->height? clip->y1: fb->height;
+  cx0 = x < x0? x0 - x: 0;
+  cy0 = y < y0? y0 - y: 0;
+  cx1 = x + w > x1? x1 - x: w;
+  cy1 = y + height > y1? y1 - y: height;
+  if ((cx0 >= cx1) || (cy0 >= cy1))
+    return w;
+
+  span += cy0 * atlas->stride + cx0;
+  dst = fb->pixels + (y + cy0) * fb->width + x + cx0;
+  for (; cy0 < cy1; cy0++, span += atlas->stride, dst += fb->width)
+    memcpy(dst, span, (cx1 - cx0) * sizeof(uint16_t));
+
+  return w;
+}
+
+int font_atlas_draw_char(fb_t *fb, const font_atlas_t *atlas,
+                         int x, int y, int ch)
+{
+  fb_rect_t all = {0, 0, fb->width, fb->height};
+
+  return font_atlas_draw_char_clip(fb, atlas, x, y, ch, &all);
+}
+
+int font_atlas_draw_text_clip(fb_t *fb, const font_atlas_t *atlas,
+                              int x, int y, const char *text,
+                              const fb_rect_t *clip)
+{
+  int x1 = clip->x1 < fb->width? clip->x1: fb->width;
+
+  for (; *text; text++) {
+    x += font_atlas_draw_char_clip(fb, atlas, x, y, *text, clip);
+    if (x >= x1)
+      break;
+  }
+
+  return x;
+}
+
+int font_atlas_draw_text(fb_t *fb, const font_atlas_t *atlas,
+                         int x, int y, const char *text)
+{
+  fb_rect_t all = {0, 0, fb->width, fb->height};
+
+  return font_atlas_draw_text_clip(fb, atlas, x, y, text, &all);
+}
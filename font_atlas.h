@@ -0,0 +1,61 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  font_atlas.h      - text rendering from pre-expanded glyph atlas
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FONT_ATLAS_H
+#define FONT_ATLAS_H
+
+#include <stdint.h>
+
+#include "font_types.h"
+#include "framebuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Every glyph of the font is expanded once into RGB565 rows for the
+  given foreground/background pair, drawing is then a row copy.
+*/
+typedef struct font_atlas_t {
+  const font_descriptor_t *font;
+  uint16_t  fg;
+  uint16_t  bg;
+  int       stride;       /* pixels reserved per glyph row */
+  uint16_t *spans;        /* size * height * stride pixels */
+  unsigned char *width;   /* advance of each glyph */
+} font_atlas_t;
+
+int font_atlas_init(font_atlas_t *atlas, const font_descriptor_t *font,
+                    uint16_t fg, uint16_t bg);
+
+void font_atlas_free(font_atlas_t *atlas);
+
+/* Returns advance in pixels, 0 when the font has no such glyph */
+int font_atlas_draw_char(fb_t *fb, const font_atlas_t *atlas,
+                         int x, int y, int ch);
+
+/* Returns x coordinate following the last drawn character */
+int font_atlas_draw_text(fb_t *fb, const font_atlas_t *atlas,
+                         int x, int y, const char *text);
+
+/* Variants drawing only the part inside clip */
+int font_atlas_draw_char_clip(fb_t *fb, const font_atlas_t *atlas,
+                              int x, int y, int ch, const fb_rect_t *clip);
+
+int font_atlas_draw_text_clip(fb_t *fb, const font_atlas_t *atlas,
+                              int x, int y, const char *text,
+                              const fb_rect_t *clip);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FONT_ATLAS_H*/
@@ -1,4 +1,4 @@
-/* Generated by convfnt.exe, modified removed offset array*/
+/* Generated by convfnt.exe*/
 #include "font_types.h"
 
 /* Windows FreeSystem 14x16 Font */
@@ -8301,9 +8301,8 @@ static font_bits_t winFreeSystem14x16_bits[] = {
 
 };
 
-#if 0000
 /* Character->glyph data. */
-static uint32_t winFreeSystem14x16_offset[] = {
+static const uint32_t winFreeSystem14x16_offset[] = {
   0,	 /*   (0x20) */
   16,	 /* ! (0x21) */
   32,	 /* " (0x22) */
@@ -8529,10 +8528,9 @@ static uint32_t winFreeSystem14x16_offset[] = {
   3552,	 /* � (0xfe) */
   3568,	 /* � (0xff) */
 };
-#endif
 
 /* Character width data. */
-static unsigned char winFreeSystem14x16_width[] = {
+static const unsigned char winFreeSystem14x16_width[] = {
   4,	 /*   (0x20) */
   4,	 /* ! (0x21) */
   6,	 /* " (0x22) */
@@ -8768,6 +8766,8 @@ font_descriptor_t font_winFreeSystem14x16 = {
 	32,
 	224,
 	winFreeSystem14x16_bits,
-	0 /*winFreeSystem14x16_offset*/,
+	winFreeSystem14x16_offset,
 	winFreeSystem14x16_width,
+	32,
+	sizeof(winFreeSystem14x16_bits) / sizeof(winFreeSystem14x16_bits[0]),
 };
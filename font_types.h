@@ -19,6 +19,7 @@
 #define FONT_TYPES_H
 
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,49 @@ extern font_descriptor_t font_winFreeSystem14x16;
 
 extern font_descriptor_t font_rom8x16;
 
+/*
+  Constant time glyph lookup. Characters outside of the font resolve
+  to defaultchar, -1 is returned when even that one is missing.
+*/
+static inline int font_glyph_index(const font_descriptor_t *font, int ch)
+{
+        int idx = ch - font->firstchar;
+
+        if ((unsigned)idx >= (unsigned)font->size)
+                idx = font->defaultchar - font->firstchar;
+        if ((unsigned)idx >= (unsigned)font->size)
+                return -1;
+        return idx;
+}
+
+static inline const font_bits_t *font_glyph_bits(const font_descriptor_t *font, int idx)
+{
+        return font->bits + (font->offset? font->offset[idx]: (uint32_t)idx * font->height);
+}
+
+static inline int font_glyph_width(const font_descriptor_t *font, int idx)
+{
+        return font->width? font->width[idx]: font->maxwidth;
+}
+
+/* Text advance in pixels, only width table is consulted */
+static inline int font_text_width(const font_descriptor_t *font, const char *text)
+{
+        int w = 0;
+        int idx;
+
+        /* fixed width fonts advance the same for every character */
+        if (!font->width)
+                return (int)strlen(text) * font->maxwidth;
+
+        for (; *text; text++) {
+                idx = font_glyph_index(font, (unsigned char)*text);
+                if (idx >= 0)
+                        w += font->width[idx];
+        }
+        return w;
+}
+
 #ifdef __cplusplus
 } /* extern "C"*/
 #endif
@@ -0,0 +1,100 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  framebuffer.c      - off-screen RGB565 framebuffer for parallel LCD
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+#include "mzapo_parlcd.h"
+
+/* cache line aligned so rows stream well into the data cache */
+#define FB_ALIGN 64
+
+int fb_init(fb_t *fb, int width, int height)
+{
+  void *mem;
+
+  fb->pixels = NULL;
+  fb->width = 0;
+  fb->height = 0;
+
+  if ((width <= 0) || (height <= 0))
+    return -1;
+
+  if (posix_memalign(&mem, FB_ALIGN, (size_t)width * height * sizeof(uint16_t)))
+    return -1;
+
+  fb->pixels = (uint16_t *)mem;
+  fb->width = width;
+  fb->height = height;
+
+  return 0;
+}
+
+void fb_free(fb_t *fb)
+{
+  free(fb->pixels);
+  fb->pixels = NULL;
+  fb->width = 0;
+  fb->height = 0;
+}
+
+void fb_fill(fb_t *fb, uint16_t color)
+{
+  fb_span_fill(fb->pixels, fb->width * fb->height, color);
+}
+
+void fb_fill_rect(fb_t *fb, const fb_rect_t *r, uint16_t color)
+{
+  int x0 = r->x0 < 0 ? 0 : r->x0;
+  int y0 = r->y0 < 0 ? 0 : r->y0;
+  int x1 = r->x1 > fb->width ? fb->width : r->x1;
+  int y1 = r->y1 > fb->height ? fb->height : r->y1;
+  uint16_t *row;
+  int y;
+
+  if ((x0 >= x1) || (y0 >= y1))
+    return;
+
+  row = fb->pixels + y0 * fb->width + x0;
+  for (y = y0; y < y1; y++, row += fb->width)
+    fb_span_fill(row, x1 - x0, color);
+}
+
+void fb_flush(fb_t *fb, unsigned char *parlcd_mem_base)
+{
+  /* partial updates may have left a narrower window behind */
+  parlcd_set_window(parlcd_mem_base, 0, 0, fb->width - 1, fb->height - 1);
+  parlcd_write_cmd(parlcd_mem_base, 0x2c); // Memory write
+  parlcd_write_pixels(parlcd_mem_base, fb->pixels,
+                      (size_t)fb->width * fb->height);
+}
+
+void fb_flush_rect(fb_t *fb, const fb_rect_t *r, unsigned char *parlcd_mem_base)
+{
+  int x0 = r->x0 < 0 ? 0 : r->x0;
+  int y0 = r->y0 < 0 ? 0 : r->y0;
+  int x1 = r->x1 > fb->width ? fb->width : r->x1;
+  int y1 = r->y1 > fb->height ? fb->height : r->y1;
+  const uint16_t *row;
+  int y;
+
+  if ((x0 >= x1) || (y0 >= y1))
+    return;
+
+  parlcd_set_window(parlcd_mem_base, x0, y0, x1 - 1, y1 - 1);
+  parlcd_write_cmd(parlcd_mem_base, 0x2c); // Memory write
+
+  row = fb->pixels + y0 * fb->width + x0;
+  for (y = y0; y < y1; y++, row += fb->width)
+    parlcd_write_pixels(parlcd_mem_base, row, x1 - x0);
+}
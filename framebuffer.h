@@ -0,0 +1,72 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  framebuffer.h      - off-screen RGB565 framebuffer for parallel LCD
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+
+#include "fb_kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FB_RGB565(r, g, b) \
+  ((uint16_t)((((r) & 0xf8) << 8) | (((g) & 0xfc) << 3) | (((b) & 0xf8) >> 3)))
+
+/* Rectangle with exclusive x1, y1 corner */
+typedef struct fb_rect_t {
+  int x0, y0;
+  int x1, y1;
+} fb_rect_t;
+
+/* In-RAM image of the panel, rows stored one after another */
+typedef struct fb_t {
+  uint16_t *pixels;
+  int       width;
+  int       height;
+} fb_t;
+
+/*
+  Fills count pixels from dst, the single kernel all solid drawing
+  ends in
+*/
+static inline void fb_span_fill(uint16_t *dst, int count, uint16_t color)
+{
+  fb_kern.span_fill(dst, count, color);
+}
+
+int fb_init(fb_t *fb, int width, int height);
+
+void fb_free(fb_t *fb);
+
+void fb_fill(fb_t *fb, uint16_t color);
+
+/* Fills the rectangle clipped to the framebuffer */
+void fb_fill_rect(fb_t *fb, const fb_rect_t *r, uint16_t color);
+
+static inline void fb_put_pixel(fb_t *fb, int x, int y, uint16_t color)
+{
+  if ((unsigned)x < (unsigned)fb->width && (unsigned)y < (unsigned)fb->height)
+    fb->pixels[y * fb->width + x] = color;
+}
+
+/* Transfers the whole buffer with one memory write (0x2C) command */
+void fb_flush(fb_t *fb, unsigned char *parlcd_mem_base);
+
+/* Transfers only the rectangle, the address window is narrowed to it */
+void fb_flush_rect(fb_t *fb, const fb_rect_t *r, unsigned char *parlcd_mem_base);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*FRAMEBUFFER_H*/
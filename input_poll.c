@@ -0,0 +1,241 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  input_poll.c      - knobs, buttons and keyboard poller with lock-free event queue
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "input_poll.h"
+#include "mzapo_regs.h"
+
+/*
+  SPILED_REG_KNOBS_8BIT_o holds blue, green and red knob positions in
+  bytes 0, 1 and 2 and the knob push buttons in bits 24, 25 and 26.
+*/
+#define INPUT_BUTTON_SHIFT 24
+
+static void input_push(input_poll_t *ip, int type, int knob, int delta,
+                       uint64_t time_ns)
+{
+  unsigned head = ip->head;
+  input_event_t *ev;
+
+  if (head - __atomic_load_n(&ip->tail, __ATOMIC_ACQUIRE) >= INPUT_RING_LEN) {
+    __atomic_add_fetch(&ip->overruns, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  ev = &ip->ring[head & (INPUT_RING_LEN - 1)];
+  ev->type = type;
+  ev->knob = knob;
+  ev->delta = delta;
+  ev->time_ns = time_ns;
+  __atomic_store_n(&ip->head, head + 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&ip->events, 1, __ATOMIC_RELAXED);
+}
+
+#define INPUT_TIME_ACTIVE  0
+#define INPUT_TIME_DECAY   1
+#define INPUT_TIME_IDLE    2
+
+static inline uint64_t input_ts_ns(const struct timespec *ts)
+{
+  return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/*
+  The keypad rows are strobed one at a time through the low bits of
+  SPILED_REG_LED_KBDWR_DIRECT_o, the columns of the strobed row come
+  back in the low bits of SPILED_REG_KBDRD_KNOBS_DIRECT_o once the
+  SPI link has refreshed both words. A set bit is a pressed key.
+*/
+#define INPUT_KBD_STROBE_m  ((1 << INPUT_KBD_ROWS) - 1)
+#define INPUT_KBD_RETURN_m  ((1 << INPUT_KBD_COLS) - 1)
+#define INPUT_KBD_SETTLE_NS 50000
+
+static uint32_t input_read_keys(unsigned char *spiled_mem_base)
+{
+  volatile uint32_t *wr = (volatile uint32_t *)(spiled_mem_base +
+                                                SPILED_REG_LED_KBDWR_DIRECT_o);
+  volatile uint32_t *rd = (volatile uint32_t *)(spiled_mem_base +
+                                                SPILED_REG_KBDRD_KNOBS_DIRECT_o);
+  struct timespec settle = {.tv_sec = 0, .tv_nsec = INPUT_KBD_SETTLE_NS};
+  uint32_t other = *wr & ~INPUT_KBD_STROBE_m;
+  uint32_t keys = 0;
+  int row;
+
+  for (row = 0; row < INPUT_KBD_ROWS; row++) {
+    *wr = other | (1 << row);
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &settle, NULL);
+    keys |= (*rd & INPUT_KBD_RETURN_m) << (row * INPUT_KBD_COLS);
+  }
+  *wr = other;
+
+  return keys;
+}
+
+/* Returns nonzero when the sample differs from the previous one */
+static int input_sample(input_poll_t *ip, uint64_t time_ns)
+{
+  uint32_t now = *(volatile uint32_t *)(ip->spiled_mem_base + SPILED_REG_KNOBS_8BIT_o);
+  uint32_t keys = input_read_keys(ip->spiled_mem_base);
+  uint32_t prev = ip->last;
+  uint32_t changed = keys ^ ip->last_keys;
+  int k;
+
+  __atomic_add_fetch(&ip->samples, 1, __ATOMIC_RELAXED);
+
+  if ((now == prev) && !changed)
+    return 0;
+
+  for (k = 0; changed; k++, changed >>= 1)
+    if (changed & 1)
+      input_push(ip, keys & (1u << k)? INPUT_EV_KEY_PRESS: INPUT_EV_KEY_RELEASE,
+                 k, 0, time_ns);
+  __atomic_store_n(&ip->last_keys, keys, __ATOMIC_RELAXED);
+
+  for (k = 0; k < INPUT_KNOBS; k++) {
+    /* 8-bit counters, signed difference handles the wraparound */
+    int8_t delta = (uint8_t)(now >> (k * 8)) - (uint8_t)(prev >> (k * 8));
+    uint32_t button = 1 << (INPUT_BUTTON_SHIFT + k);
+
+    if (delta)
+      input_push(ip, INPUT_EV_ROTATE, k, delta, time_ns);
+    if ((now ^ prev) & button)
+      input_push(ip, now & button? INPUT_EV_PRESS: INPUT_EV_RELEASE, k, 0, time_ns);
+  }
+
+  __atomic_store_n(&ip->last, now, __ATOMIC_RELAXED);
+
+  return 1;
+}
+
+/* Period for the next sample, doubles towards idle after the hold time */
+static long input_next_period(input_poll_t *ip, uint64_t since_activity_ns)
+{
+  long period = ip->period_ns;
+
+  if (since_activity_ns < (uint64_t)ip->hold_ns)
+    return ip->active_period_ns;
+
+  period *= 2;
+  if (period > ip->idle_period_ns)
+    period = ip->idle_period_ns;
+
+  return period;
+}
+
+static void *input_poll_thread(void *arg)
+{
+  input_poll_t *ip = (input_poll_t *)arg;
+  struct timespec next;
+  uint64_t now_ns;
+  uint64_t activity_ns;
+  int bucket;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  activity_ns = input_ts_ns(&next);
+
+  while (!__atomic_load_n(&ip->stop, __ATOMIC_ACQUIRE)) {
+    now_ns = input_ts_ns(&next);
+    if (input_sample(ip, now_ns))
+      activity_ns = now_ns;
+
+    ip->period_ns = input_next_period(ip, now_ns - activity_ns);
+
+    if (ip->period_ns <= ip->active_period_ns)
+      bucket = INPUT_TIME_ACTIVE;
+    else if (ip->period_ns >= ip->idle_period_ns)
+      bucket = INPUT_TIME_IDLE;
+    else
+      bucket = INPUT_TIME_DECAY;
+    __atomic_add_fetch(&ip->time_ns[bucket], ip->period_ns, __ATOMIC_RELAXED);
+
+    next.tv_nsec += ip->period_ns;
+    while (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+  }
+
+  return NULL;
+}
+
+int input_poll_start_adaptive(input_poll_t *ip, unsigned char *spiled_mem_base,
+                              const input_poll_cfg_t *cfg)
+{
+  struct timespec ts;
+  int idle_hz = cfg->idle_rate_hz > 0? cfg->idle_rate_hz: 100;
+  int active_hz = cfg->active_rate_hz > idle_hz? cfg->active_rate_hz: idle_hz;
+
+  ip->spiled_mem_base = spiled_mem_base;
+  ip->active_period_ns = 1000000000L / active_hz;
+  ip->idle_period_ns = 1000000000L / idle_hz;
+  ip->hold_ns = cfg->hold_ms * 1000000L;
+  ip->period_ns = ip->active_period_ns;
+  ip->stop = 0;
+  ip->head = 0;
+  ip->tail = 0;
+  ip->overruns = 0;
+  ip->samples = 0;
+  ip->events = 0;
+  ip->time_ns[INPUT_TIME_ACTIVE] = 0;
+  ip->time_ns[INPUT_TIME_DECAY] = 0;
+  ip->time_ns[INPUT_TIME_IDLE] = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ip->start_ns = input_ts_ns(&ts);
+
+  /* the current state is the reference, no events for it */
+  ip->last = *(volatile uint32_t *)(spiled_mem_base + SPILED_REG_KNOBS_8BIT_o);
+  ip->last_keys = input_read_keys(spiled_mem_base);
+
+  if (pthread_create(&ip->thread, NULL, input_poll_thread, ip))
+    return -1;
+
+  return 0;
+}
+
+int input_poll_start(input_poll_t *ip, unsigned char *spiled_mem_base, int rate_hz)
+{
+  input_poll_cfg_t cfg = {.idle_rate_hz = rate_hz, .active_rate_hz = rate_hz};
+
+  return input_poll_start_adaptive(ip, spiled_mem_base, &cfg);
+}
+
+void input_poll_stop(input_poll_t *ip)
+{
+  __atomic_store_n(&ip->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(ip->thread, NULL);
+}
+
+void input_poll_get_stats(input_poll_t *ip, input_poll_stats_t *stats)
+{
+  struct timespec ts;
+  double elapsed;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  stats->elapsed_ns = input_ts_ns(&ts) - ip->start_ns;
+  stats->samples = __atomic_load_n(&ip->samples, __ATOMIC_RELAXED);
+  stats->events = __atomic_load_n(&ip->events, __ATOMIC_RELAXED);
+  stats->overruns = __atomic_load_n(&ip->overruns, __ATOMIC_RELAXED);
+  stats->time_active_ns = __atomic_load_n(&ip->time_ns[INPUT_TIME_ACTIVE], __ATOMIC_RELAXED);
+  stats->time_decay_ns = __atomic_load_n(&ip->time_ns[INPUT_TIME_DECAY], __ATOMIC_RELAXED);
+  stats->time_idle_ns = __atomic_load_n(&ip->time_ns[INPUT_TIME_IDLE], __ATOMIC_RELAXED);
+
+  elapsed = stats->elapsed_ns * 1e-9;
+  stats->samples_per_s = elapsed > 0? stats->samples / elapsed: 0;
+  stats->events_per_s = elapsed > 0? stats->events / elapsed: 0;
+}
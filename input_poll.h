@@ -0,0 +1,137 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  input_poll.h      - knobs, buttons and keyboard poller with lock-free event queue
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef INPUT_POLL_H
+#define INPUT_POLL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INPUT_KNOB_BLUE   0
+#define INPUT_KNOB_GREEN  1
+#define INPUT_KNOB_RED    2
+#define INPUT_KNOBS       3
+
+#define INPUT_EV_ROTATE   1
+#define INPUT_EV_PRESS    2
+#define INPUT_EV_RELEASE  3
+#define INPUT_EV_KEY_PRESS    4
+#define INPUT_EV_KEY_RELEASE  5
+
+/*
+  Keypad matrix scanned row by row, key events carry the key number
+  row * INPUT_KBD_COLS + column
+*/
+#define INPUT_KBD_ROWS    3
+#define INPUT_KBD_COLS    4
+#define INPUT_KEYS        (INPUT_KBD_ROWS * INPUT_KBD_COLS)
+
+/* Must be power of two */
+#define INPUT_RING_LEN    256
+
+typedef struct input_event_t {
+  uint8_t  type;
+  uint8_t  knob;         /* key number for key events */
+  int16_t  delta;        /* rotation steps, positive clockwise */
+  uint64_t time_ns;      /* CLOCK_MONOTONIC of the sample */
+} input_event_t;
+
+/*
+  Sampling runs at active_rate_hz after any change, stays there for
+  hold_ms and then the period doubles each sample until it reaches
+  idle_rate_hz. Equal rates give fixed rate polling.
+*/
+typedef struct input_poll_cfg_t {
+  int idle_rate_hz;
+  int active_rate_hz;
+  int hold_ms;
+} input_poll_cfg_t;
+
+typedef struct input_poll_stats_t {
+  unsigned long samples;
+  unsigned long events;
+  unsigned long overruns;
+  uint64_t      elapsed_ns;
+  uint64_t      time_active_ns;   /* sampling at the active rate */
+  uint64_t      time_decay_ns;    /* between the rates */
+  uint64_t      time_idle_ns;     /* sampling at the idle rate */
+  double        samples_per_s;
+  double        events_per_s;
+} input_poll_stats_t;
+
+/*
+  Single producer (poller thread) and single consumer (application)
+  ring, each index is written by one side only.
+*/
+typedef struct input_poll_t {
+  unsigned char *spiled_mem_base;
+  long           active_period_ns;
+  long           idle_period_ns;
+  long           hold_ns;
+  long           period_ns;       /* current sampling period */
+  int            stop;
+  pthread_t      thread;
+  uint32_t       last;         /* last SPILED_REG_KNOBS_8BIT_o value */
+  uint32_t       last_keys;    /* pressed keys, bit per key number */
+  unsigned       head;
+  unsigned       tail;
+  unsigned long  overruns;     /* events lost on full ring */
+  unsigned long  samples;
+  unsigned long  events;
+  uint64_t       start_ns;
+  uint64_t       time_ns[3];   /* active, decay and idle time */
+  input_event_t  ring[INPUT_RING_LEN];
+} input_poll_t;
+
+/* Polls at fixed rate */
+int input_poll_start(input_poll_t *ip, unsigned char *spiled_mem_base, int rate_hz);
+
+int input_poll_start_adaptive(input_poll_t *ip, unsigned char *spiled_mem_base,
+                              const input_poll_cfg_t *cfg);
+
+void input_poll_stop(input_poll_t *ip);
+
+/* Returns 1 and fills event when available, 0 otherwise */
+static inline int input_poll_get(input_poll_t *ip, input_event_t *ev)
+{
+  unsigned tail = ip->tail;
+
+  if (tail == __atomic_load_n(&ip->head, __ATOMIC_ACQUIRE))
+    return 0;
+
+  *ev = ip->ring[tail & (INPUT_RING_LEN - 1)];
+  __atomic_store_n(&ip->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+void input_poll_get_stats(input_poll_t *ip, input_poll_stats_t *stats);
+
+/* Latest knob positions and buttons as read from the register */
+static inline uint32_t input_poll_raw(input_poll_t *ip)
+{
+  return __atomic_load_n(&ip->last, __ATOMIC_RELAXED);
+}
+
+/* Latest pressed keys, bit per key number */
+static inline uint32_t input_poll_raw_keys(input_poll_t *ip)
+{
+  return __atomic_load_n(&ip->last_keys, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*INPUT_POLL_H*/
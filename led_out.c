@@ -0,0 +1,218 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  led_out.c      - LED line and RGB LEDs output with shadow registers
+                   and simple animations
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "led_out.h"
+#include "mzapo_regs.h"
+
+static const unsigned led_reg_offs[LED_CHANNELS] = {
+  SPILED_REG_LED_LINE_o,
+  SPILED_REG_LED_RGB1_o,
+  SPILED_REG_LED_RGB2_o,
+};
+
+static uint64_t led_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t led_mix(uint32_t from, uint32_t to, uint64_t pos, uint64_t len)
+{
+  uint32_t res = 0;
+  int shift;
+
+  /* 0x00RRGGBB, each byte interpolated separately, 64-bit for long periods */
+  for (shift = 0; shift < 24; shift += 8) {
+    int64_t a = (from >> shift) & 0xff;
+    int64_t b = (to >> shift) & 0xff;
+    res |= (uint32_t)(a + (b - a) * (int64_t)pos / (int64_t)len) << shift;
+  }
+
+  return res;
+}
+
+static uint32_t led_anim_value(led_anim_t *an, uint64_t now_ns)
+{
+  uint64_t t_ms = (now_ns - an->start_ns) / 1000000;
+  uint64_t pos;
+
+  switch (an->type) {
+    case LED_ANIM_BLINK:
+      return (t_ms % an->period_ms) < an->period_ms / 2? an->a: an->b;
+    case LED_ANIM_FADE:
+      if (!an->repeat) {
+        if (t_ms >= an->period_ms) {
+          an->type = LED_ANIM_NONE;
+          return an->b;
+        }
+        return led_mix(an->a, an->b, t_ms, an->period_ms);
+      }
+      pos = t_ms % (2 * (uint64_t)an->period_ms);
+      if (pos >= an->period_ms)
+        pos = 2 * (uint64_t)an->period_ms - pos;
+      return led_mix(an->a, an->b, pos, an->period_ms);
+    case LED_ANIM_PATTERN:
+      return an->seq[(t_ms / an->period_ms) % an->seq_len];
+  }
+
+  return 0;
+}
+
+static void *led_out_thread(void *arg)
+{
+  led_out_t *lo = (led_out_t *)arg;
+  struct timespec next;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!__atomic_load_n(&lo->stop, __ATOMIC_ACQUIRE)) {
+    led_out_commit(lo);
+
+    next.tv_nsec += lo->period_ns;
+    while (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+  }
+
+  return NULL;
+}
+
+int led_out_init(led_out_t *lo, unsigned char *spiled_mem_base, int tick_hz)
+{
+  int ch;
+
+  memset(lo, 0, sizeof(*lo));
+  lo->spiled_mem_base = spiled_mem_base;
+  pthread_mutex_init(&lo->lock, NULL);
+
+  /* start from what the hardware shows */
+  for (ch = 0; ch < LED_CHANNELS; ch++) {
+    lo->shadow[ch] = *(volatile uint32_t *)(spiled_mem_base + led_reg_offs[ch]);
+    lo->value[ch] = lo->shadow[ch];
+  }
+
+  if (tick_hz <= 0)
+    return 0;
+
+  lo->period_ns = 1000000000L / tick_hz;
+  if (pthread_create(&lo->thread, NULL, led_out_thread, lo)) {
+    pthread_mutex_destroy(&lo->lock);
+    return -1;
+  }
+  lo->running = 1;
+
+  return 0;
+}
+
+void led_out_done(led_out_t *lo)
+{
+  if (lo->running) {
+    __atomic_store_n(&lo->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(lo->thread, NULL);
+    lo->running = 0;
+  }
+  pthread_mutex_destroy(&lo->lock);
+}
+
+void led_out_set(led_out_t *lo, int ch, uint32_t value)
+{
+  pthread_mutex_lock(&lo->lock);
+  lo->anim[ch].type = LED_ANIM_NONE;
+  lo->value[ch] = value;
+  pthread_mutex_unlock(&lo->lock);
+}
+
+void led_out_bar(led_out_t *lo, int value, int max)
+{
+  int n = max > 0? value * 32 / max: 0;
+
+  if (n < 0)
+    n = 0;
+  led_out_set(lo, LED_CH_LINE, n >= 32? 0xffffffff: ~(0xffffffff >> n));
+}
+
+static void led_out_start_anim(led_out_t *lo, int ch, const led_anim_t *an)
+{
+  pthread_mutex_lock(&lo->lock);
+  lo->anim[ch] = *an;
+  lo->anim[ch].start_ns = led_now_ns();
+  pthread_mutex_unlock(&lo->lock);
+}
+
+void led_out_blink(led_out_t *lo, int ch, uint32_t on, uint32_t off,
+                   uint32_t period_ms)
+{
+  led_anim_t an = {.type = LED_ANIM_BLINK, .a = on, .b = off,
+                   .period_ms = period_ms? period_ms: 1};
+
+  led_out_start_anim(lo, ch, &an);
+}
+
+void led_out_fade(led_out_t *lo, int ch, uint32_t from, uint32_t to,
+                  uint32_t period_ms, int repeat)
+{
+  led_anim_t an = {.type = LED_ANIM_FADE, .a = from, .b = to,
+                   .period_ms = period_ms? period_ms: 1, .repeat = repeat};
+
+  led_out_start_anim(lo, ch, &an);
+}
+
+void led_out_pattern(led_out_t *lo, int ch, const uint32_t *seq, int len,
+                     uint32_t step_ms)
+{
+  led_anim_t an = {.type = LED_ANIM_PATTERN, .period_ms = step_ms? step_ms: 1};
+
+  if (len <= 0)
+    return;
+  if (len > LED_PATTERN_MAX)
+    len = LED_PATTERN_MAX;
+  an.seq_len = len;
+  memcpy(an.seq, seq, len * sizeof(*seq));
+
+  led_out_start_anim(lo, ch, &an);
+}
+
+void led_out_commit(led_out_t *lo)
+{
+  uint64_t now_ns = led_now_ns();
+  uint32_t value;
+  int ch;
+
+  pthread_mutex_lock(&lo->lock);
+  for (ch = 0; ch < LED_CHANNELS; ch++) {
+    if (lo->anim[ch].type != LED_ANIM_NONE)
+      lo->value[ch] = led_anim_value(&lo->anim[ch], now_ns);
+    value = lo->value[ch];
+
+    /* slow SPI side registers are touched only when something changed */
+    if (value == lo->shadow[ch]) {
+      lo->coalesced++;
+      continue;
+    }
+    *(volatile uint32_t *)(lo->spiled_mem_base + led_reg_offs[ch]) = value;
+    lo->shadow[ch] = value;
+    lo->writes++;
+  }
+  pthread_mutex_unlock(&lo->lock);
+}
@@ -0,0 +1,95 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  led_out.h      - LED line and RGB LEDs output with shadow registers
+                   and simple animations
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef LED_OUT_H
+#define LED_OUT_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_CH_LINE     0
+#define LED_CH_RGB1     1
+#define LED_CH_RGB2     2
+#define LED_CHANNELS    3
+
+#define LED_ANIM_NONE     0
+#define LED_ANIM_BLINK    1
+#define LED_ANIM_FADE     2
+#define LED_ANIM_PATTERN  3
+
+#define LED_PATTERN_MAX   16
+
+typedef struct led_anim_t {
+  int       type;
+  uint32_t  a;             /* blink on value, fade start */
+  uint32_t  b;             /* blink off value, fade end */
+  uint32_t  period_ms;     /* blink/fade period, pattern step */
+  int       repeat;        /* fade goes back and forth */
+  int       seq_len;
+  uint32_t  seq[LED_PATTERN_MAX];
+  uint64_t  start_ns;
+} led_anim_t;
+
+/*
+  Values requested by the application are kept apart from shadow
+  copies of the registers, a register is written only on commit
+  and only when its value differs from the shadow.
+*/
+typedef struct led_out_t {
+  unsigned char  *spiled_mem_base;
+  pthread_mutex_t lock;
+  uint32_t        value[LED_CHANNELS];
+  uint32_t        shadow[LED_CHANNELS];
+  led_anim_t      anim[LED_CHANNELS];
+  long            period_ns;
+  int             stop;
+  int             running;
+  pthread_t       thread;
+  unsigned long   writes;
+  unsigned long   coalesced;   /* commits without register write */
+} led_out_t;
+
+/*
+  With tick_hz nonzero a timer thread runs animations and commits
+  each tick, otherwise the application calls led_out_commit().
+*/
+int led_out_init(led_out_t *lo, unsigned char *spiled_mem_base, int tick_hz);
+
+void led_out_done(led_out_t *lo);
+
+/* Sets static value, stops animation running on the channel */
+void led_out_set(led_out_t *lo, int ch, uint32_t value);
+
+/* Lights value * 32 / max LEDs of the line from the left */
+void led_out_bar(led_out_t *lo, int value, int max);
+
+void led_out_blink(led_out_t *lo, int ch, uint32_t on, uint32_t off,
+                   uint32_t period_ms);
+
+/* Linear fade of RGB channels, repeat bounces between the colors */
+void led_out_fade(led_out_t *lo, int ch, uint32_t from, uint32_t to,
+                  uint32_t period_ms, int repeat);
+
+void led_out_pattern(led_out_t *lo, int ch, const uint32_t *seq, int len,
+                     uint32_t step_ms);
+
+/* Evaluates animations and writes changed registers */
+void led_out_commit(led_out_t *lo);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*LED_OUT_H*/
@@ -0,0 +1,310 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  motor_ctl.c      - fixed-point PID position/velocity control of
+                     DC motors with deterministic loop timing
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "motor_ctl.h"
+#include "mzapo_regs.h"
+
+/* Stack touched before the loop starts so that it never faults */
+#define MOTOR_STACK_PREFAULT  (16 * 1024)
+
+/* Position error beyond this is clamped before multiplication */
+#define MOTOR_ERR_MAX         ((int64_t)1 << 30)
+
+static const long motor_jitter_bounds[MOTOR_JITTER_BINS] = MOTOR_JITTER_BOUNDS;
+
+static inline int64_t ts_ns(const struct timespec *ts)
+{
+  return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static inline void motor_write_duty(unsigned char *base, int32_t out)
+{
+  uint32_t duty;
+
+  if (out > 0)
+    duty = out | DCSPDRV_REG_DUTY_DIR_A_m;
+  else if (out < 0)
+    duty = -out | DCSPDRV_REG_DUTY_DIR_B_m;
+  else
+    duty = 0;
+  *(volatile uint32_t *)(base + DCSPDRV_REG_DUTY_o) = duty;
+}
+
+static inline int64_t motor_clamp(int64_t v, int64_t lim)
+{
+  return v > lim? lim: v < -lim? -lim: v;
+}
+
+static void motor_account_period(motor_ctl_stats_t *st, long period_ns, long dev_ns)
+{
+  long dev_us = (dev_ns < 0? -dev_ns: dev_ns) / 1000;
+  int bin;
+
+  for (bin = 0; bin < MOTOR_JITTER_BINS - 1; bin++)
+    if (dev_us < motor_jitter_bounds[bin])
+      break;
+  st->jitter_hist[bin]++;
+  if (period_ns < st->period_min_ns)
+    st->period_min_ns = period_ns;
+  if (period_ns > st->period_max_ns)
+    st->period_max_ns = period_ns;
+}
+
+/* Picks up new commands, never waits for the application */
+static void motor_take_cmd(motor_ctl_t *mc)
+{
+  unsigned seq = __atomic_load_n(&mc->cmd_seq, __ATOMIC_ACQUIRE);
+  motor_axis_t *ax;
+  int a;
+
+  if (seq == mc->cmd_seen)
+    return;
+  if (pthread_mutex_trylock(&mc->cmd_lock))
+    return;
+
+  for (a = 0; a < MOTOR_IRC_AXES; a++) {
+    ax = &mc->axis[a];
+    if (ax->mode != mc->cmd[a].mode)
+      ax->integ = 0;
+    ax->mode = mc->cmd[a].mode;
+    ax->pid = mc->cmd[a].pid;
+    ax->setpoint = mc->cmd[a].setpoint;
+  }
+  mc->cmd_seen = seq;
+
+  pthread_mutex_unlock(&mc->cmd_lock);
+}
+
+static int32_t motor_pid(motor_axis_t *ax, const motor_irc_state_t *fb,
+                         int64_t limit)
+{
+  int64_t e, u;
+
+  switch (ax->mode) {
+    case MOTOR_MODE_POSITION:
+      e = motor_clamp(ax->setpoint - fb->pos, MOTOR_ERR_MAX);
+      break;
+    case MOTOR_MODE_VELOCITY:
+      e = motor_clamp(ax->setpoint - fb->vel, MOTOR_ERR_MAX);
+      break;
+    default:
+      ax->integ = 0;
+      return 0;
+  }
+
+  /* integrator is limited to full output, no windup */
+  ax->integ = motor_clamp(ax->integ + ax->pid.ki * e, limit << 16);
+  u = ax->pid.kp * e + ax->integ;
+  if (ax->mode == MOTOR_MODE_POSITION)
+    u -= (int64_t)ax->pid.kd * fb->vel;
+
+  return motor_clamp(u >> 16, limit);
+}
+
+static void *motor_ctl_thread(void *arg)
+{
+  motor_ctl_t *mc = (motor_ctl_t *)arg;
+  motor_ctl_stats_t *st = &mc->stats;
+  volatile unsigned char stack[MOTOR_STACK_PREFAULT];
+  struct timespec next, wake, done;
+  int64_t prev_ns = 0, wake_ns, done_ns, next_ns;
+  motor_axis_t *ax;
+  int a;
+
+  memset((void *)stack, 0, sizeof(stack));
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!__atomic_load_n(&mc->stop, __ATOMIC_ACQUIRE)) {
+    next.tv_nsec += mc->period_ns;
+    while (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+
+    clock_gettime(CLOCK_MONOTONIC, &wake);
+    wake_ns = ts_ns(&wake);
+    if (prev_ns)
+      motor_account_period(st, wake_ns - prev_ns, wake_ns - prev_ns - mc->period_ns);
+    prev_ns = wake_ns;
+
+    motor_irc_sample(&mc->irc, wake_ns);
+    motor_take_cmd(mc);
+
+    for (a = 0; a < MOTOR_IRC_AXES; a++) {
+      if (mc->dcspdrv_mem_base[a] == NULL)
+        continue;
+      ax = &mc->axis[a];
+      ax->out = motor_pid(ax, &mc->irc.work.axis[a], mc->pwm_period);
+      motor_write_duty(mc->dcspdrv_mem_base[a], ax->out);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &done);
+    done_ns = ts_ns(&done);
+    next_ns = ts_ns(&next);
+    if (done_ns - wake_ns > st->wcet_ns)
+      st->wcet_ns = done_ns - wake_ns;
+    if (done_ns > next_ns + mc->period_ns)
+      st->overruns++;
+    st->loops++;
+  }
+
+  return NULL;
+}
+
+int motor_ctl_init(motor_ctl_t *mc, unsigned char *dcspdrv0_mem_base,
+                   unsigned char *dcspdrv1_mem_base, uint32_t pwm_period,
+                   int loop_hz, int vel_ms)
+{
+  int a;
+
+  memset(mc, 0, sizeof(*mc));
+  if (motor_irc_init(&mc->irc, dcspdrv0_mem_base, dcspdrv1_mem_base,
+                     loop_hz, vel_ms))
+    return -1;
+
+  mc->dcspdrv_mem_base[0] = dcspdrv0_mem_base;
+  mc->dcspdrv_mem_base[1] = dcspdrv1_mem_base;
+  mc->pwm_period = pwm_period & DCSPDRV_REG_PERIOD_MASK_m;
+  mc->period_ns = mc->irc.period_ns;
+  mc->stats.period_min_ns = 0x7fffffff;
+  pthread_mutex_init(&mc->cmd_lock, NULL);
+
+  for (a = 0; a < MOTOR_IRC_AXES; a++) {
+    if (mc->dcspdrv_mem_base[a] == NULL)
+      continue;
+    *(volatile uint32_t *)(mc->dcspdrv_mem_base[a] + DCSPDRV_REG_PERIOD_o) =
+        mc->pwm_period;
+    motor_write_duty(mc->dcspdrv_mem_base[a], 0);
+  }
+
+  return 0;
+}
+
+int motor_ctl_start(motor_ctl_t *mc, int rt_priority, int cpu)
+{
+  pthread_attr_t attr;
+  struct sched_param sp;
+  cpu_set_t cpus;
+  volatile uint32_t *cr;
+  int ret = -1;
+  int a;
+
+  /* whole process stays resident, page faults would break the period */
+  mc->stats.locked = !mlockall(MCL_CURRENT | MCL_FUTURE);
+
+  for (a = 0; a < MOTOR_IRC_AXES; a++) {
+    if (mc->dcspdrv_mem_base[a] == NULL)
+      continue;
+    cr = (volatile uint32_t *)(mc->dcspdrv_mem_base[a] + DCSPDRV_REG_CR_o);
+    *cr |= DCSPDRV_REG_CR_PWM_ENABLE_m;
+  }
+
+  pthread_attr_init(&attr);
+  if (cpu >= 0) {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    mc->stats.pinned = !pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  }
+  if (rt_priority > 0) {
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    sp.sched_priority = rt_priority;
+    pthread_attr_setschedparam(&attr, &sp);
+    ret = pthread_create(&mc->thread, &attr, motor_ctl_thread, mc);
+    mc->stats.realtime = ret == 0;
+    if (ret)
+      pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+  }
+  if (ret)
+    ret = pthread_create(&mc->thread, &attr, motor_ctl_thread, mc);
+  pthread_attr_destroy(&attr);
+
+  if (ret) {
+    motor_ctl_stop(mc);
+    return -1;
+  }
+  mc->running = 1;
+
+  return 0;
+}
+
+void motor_ctl_stop(motor_ctl_t *mc)
+{
+  volatile uint32_t *cr;
+  int a;
+
+  if (mc->running) {
+    __atomic_store_n(&mc->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(mc->thread, NULL);
+    mc->running = 0;
+  }
+
+  for (a = 0; a < MOTOR_IRC_AXES; a++) {
+    if (mc->dcspdrv_mem_base[a] == NULL)
+      continue;
+    motor_write_duty(mc->dcspdrv_mem_base[a], 0);
+    cr = (volatile uint32_t *)(mc->dcspdrv_mem_base[a] + DCSPDRV_REG_CR_o);
+    *cr &= ~DCSPDRV_REG_CR_PWM_ENABLE_m;
+  }
+}
+
+static void motor_ctl_command(motor_ctl_t *mc, int axis, int mode,
+                              const motor_pid_t *pid, int64_t setpoint)
+{
+  pthread_mutex_lock(&mc->cmd_lock);
+  if (pid != NULL)
+    mc->cmd[axis].pid = *pid;
+  else
+    mc->cmd[axis].setpoint = setpoint;
+  if (mode >= 0)
+    mc->cmd[axis].mode = mode;
+  __atomic_fetch_add(&mc->cmd_seq, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&mc->cmd_lock);
+}
+
+void motor_ctl_set_pid(motor_ctl_t *mc, int axis, const motor_pid_t *pid)
+{
+  motor_ctl_command(mc, axis, -1, pid, 0);
+}
+
+void motor_ctl_set_position(motor_ctl_t *mc, int axis, int64_t pos)
+{
+  motor_ctl_command(mc, axis, MOTOR_MODE_POSITION, NULL, pos);
+}
+
+void motor_ctl_set_velocity(motor_ctl_t *mc, int axis, int64_t vel)
+{
+  motor_ctl_command(mc, axis, MOTOR_MODE_VELOCITY, NULL, vel);
+}
+
+void motor_ctl_off(motor_ctl_t *mc, int axis)
+{
+  motor_ctl_command(mc, axis, MOTOR_MODE_OFF, NULL, 0);
+}
+
+void motor_ctl_get_stats(motor_ctl_t *mc, motor_ctl_stats_t *stats)
+{
+  /* counters are owned by the loop thread, copy is not atomic */
+  *stats = mc->stats;
+}
@@ -0,0 +1,117 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  motor_ctl.h      - fixed-point PID position/velocity control of
+                     DC motors with deterministic loop timing
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef MOTOR_CTL_H
+#define MOTOR_CTL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "motor_irc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTOR_MODE_OFF       0
+#define MOTOR_MODE_POSITION  1
+#define MOTOR_MODE_VELOCITY  2
+
+/* Loop period error histogram bins, upper bounds in microseconds */
+#define MOTOR_JITTER_BINS    8
+#define MOTOR_JITTER_BOUNDS  {2, 5, 10, 20, 50, 100, 200, 0x7fffffff}
+
+/*
+  Gains are Q16. Position mode output is
+    kp * e + ki * sum(e) - kd * vel
+  velocity mode output is kp * e + ki * sum(e), e being counts or
+  counts per second respectively, output is in PWM period ticks.
+*/
+typedef struct motor_pid_t {
+  int32_t kp;
+  int32_t ki;
+  int32_t kd;
+} motor_pid_t;
+
+typedef struct motor_axis_t {
+  int          mode;
+  motor_pid_t  pid;
+  int64_t      setpoint;     /* counts or counts per second */
+  int64_t      integ;        /* Q16 */
+  int32_t      out;          /* signed duty, -period..period */
+} motor_axis_t;
+
+typedef struct motor_ctl_stats_t {
+  unsigned long loops;
+  unsigned long overruns;    /* loop finished after the next deadline */
+  long          period_min_ns;
+  long          period_max_ns;
+  long          wcet_ns;     /* longest loop body */
+  unsigned long jitter_hist[MOTOR_JITTER_BINS];
+  int           realtime;    /* SCHED_FIFO was granted */
+  int           pinned;      /* affinity was set */
+  int           locked;      /* mlockall() succeeded */
+} motor_ctl_stats_t;
+
+/*
+  Mode, gains and setpoints are changed by the application and picked
+  up by the loop through cmd_seq. The loop owns axis state and stats,
+  all storage is inside the structure so the loop never allocates.
+*/
+typedef struct motor_ctl_t {
+  unsigned char    *dcspdrv_mem_base[MOTOR_IRC_AXES];
+  uint32_t          pwm_period;
+  long              period_ns;
+  int               stop;
+  int               running;
+  pthread_t         thread;
+  pthread_mutex_t   cmd_lock;
+  unsigned          cmd_seq;
+  unsigned          cmd_seen;
+  motor_axis_t      cmd[MOTOR_IRC_AXES];
+  motor_axis_t      axis[MOTOR_IRC_AXES];
+  motor_irc_t       irc;
+  motor_ctl_stats_t stats;
+} motor_ctl_t;
+
+/*
+  Sets PWM period of both drivers (NULL base leaves axis unused) and
+  prepares the feedback sampling at loop_hz, velocity taken over vel_ms.
+*/
+int motor_ctl_init(motor_ctl_t *mc, unsigned char *dcspdrv0_mem_base,
+                   unsigned char *dcspdrv1_mem_base, uint32_t pwm_period,
+                   int loop_hz, int vel_ms);
+
+/*
+  Locks memory, starts loop thread with SCHED_FIFO rt_priority pinned
+  to cpu (negative for no pinning). Missing privileges are noted in
+  the stats and the loop runs with best effort.
+*/
+int motor_ctl_start(motor_ctl_t *mc, int rt_priority, int cpu);
+
+/* Stops the loop and disables PWM outputs */
+void motor_ctl_stop(motor_ctl_t *mc);
+
+void motor_ctl_set_pid(motor_ctl_t *mc, int axis, const motor_pid_t *pid);
+
+void motor_ctl_set_position(motor_ctl_t *mc, int axis, int64_t pos);
+
+void motor_ctl_set_velocity(motor_ctl_t *mc, int axis, int64_t vel);
+
+void motor_ctl_off(motor_ctl_t *mc, int axis);
+
+void motor_ctl_get_stats(motor_ctl_t *mc, motor_ctl_stats_t *stats);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*MOTOR_CTL_H*/
@@ -0,0 +1,179 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  motor_irc.c      - DC motor IRC encoder sampling and velocity
+                     estimation
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "motor_irc.h"
+#include "mzapo_regs.h"
+
+static uint64_t motor_irc_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *motor_irc_thread(void *arg)
+{
+  motor_irc_t *mi = (motor_irc_t *)arg;
+  struct timespec next;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!__atomic_load_n(&mi->stop, __ATOMIC_ACQUIRE)) {
+    next.tv_nsec += mi->period_ns;
+    while (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+
+    motor_irc_sample(mi, motor_irc_now_ns());
+  }
+
+  return NULL;
+}
+
+int motor_irc_init(motor_irc_t *mi, unsigned char *dcspdrv0_mem_base,
+                   unsigned char *dcspdrv1_mem_base, int rate_hz, int vel_ms)
+{
+  motor_irc_state_t *st;
+  int axis;
+
+  memset(mi, 0, sizeof(*mi));
+  if (rate_hz <= 0)
+    return -1;
+
+  mi->dcspdrv_mem_base[0] = dcspdrv0_mem_base;
+  mi->dcspdrv_mem_base[1] = dcspdrv1_mem_base;
+  mi->period_ns = 1000000000L / rate_hz;
+  mi->vel_win = (int64_t)rate_hz * vel_ms / 1000;
+  if (mi->vel_win < 1)
+    mi->vel_win = 1;
+  if (mi->vel_win > MOTOR_IRC_HIST_LEN - 1)
+    mi->vel_win = MOTOR_IRC_HIST_LEN - 1;
+
+  /* counting starts from whatever the counter holds now */
+  for (axis = 0; axis < MOTOR_IRC_AXES; axis++) {
+    if (mi->dcspdrv_mem_base[axis] == NULL)
+      continue;
+    st = &mi->work.axis[axis];
+    st->raw = *(volatile uint32_t *)(mi->dcspdrv_mem_base[axis] + DCSPDRV_REG_IRC_o);
+    st->sr = *(volatile uint32_t *)(mi->dcspdrv_mem_base[axis] + DCSPDRV_REG_SR_o);
+  }
+  mi->work.time_ns = motor_irc_now_ns();
+  mi->hist_ns[0] = mi->work.time_ns;
+  mi->snap = mi->work;
+
+  return 0;
+}
+
+int motor_irc_start(motor_irc_t *mi, int rt_priority)
+{
+  pthread_attr_t attr;
+  struct sched_param sp;
+  int ret = -1;
+
+  if (rt_priority > 0) {
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    sp.sched_priority = rt_priority;
+    pthread_attr_setschedparam(&attr, &sp);
+    ret = pthread_create(&mi->thread, &attr, motor_irc_thread, mi);
+    pthread_attr_destroy(&attr);
+    mi->realtime = ret == 0;
+  }
+
+  if (ret)
+    ret = pthread_create(&mi->thread, NULL, motor_irc_thread, mi);
+  if (ret)
+    return -1;
+  mi->running = 1;
+
+  return 0;
+}
+
+void motor_irc_stop(motor_irc_t *mi)
+{
+  if (!mi->running)
+    return;
+  __atomic_store_n(&mi->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(mi->thread, NULL);
+  mi->running = 0;
+}
+
+void motor_irc_reset(motor_irc_t *mi, int axis)
+{
+  if (mi->running) {
+    __atomic_fetch_or(&mi->reset_req, 1u << axis, __ATOMIC_RELEASE);
+    return;
+  }
+  /* no sampler thread, caller owns the state */
+  mi->reset_req |= 1u << axis;
+  motor_irc_sample(mi, motor_irc_now_ns());
+}
+
+void motor_irc_sample(motor_irc_t *mi, uint64_t now_ns)
+{
+  unsigned idx = (mi->hist_idx + 1) & (MOTOR_IRC_HIST_LEN - 1);
+  unsigned long have = mi->work.samples + 1;
+  unsigned win = have < (unsigned)mi->vel_win? have: mi->vel_win;
+  unsigned old = (idx - win) & (MOTOR_IRC_HIST_LEN - 1);
+  unsigned req = __atomic_exchange_n(&mi->reset_req, 0, __ATOMIC_ACQUIRE);
+  int64_t dt_ns = now_ns - mi->hist_ns[old];
+  motor_irc_state_t *st;
+  unsigned char *base;
+  uint32_t raw;
+  int axis, k;
+
+  for (axis = 0; axis < MOTOR_IRC_AXES; axis++) {
+    base = mi->dcspdrv_mem_base[axis];
+    if (base == NULL)
+      continue;
+    st = &mi->work.axis[axis];
+
+    raw = *(volatile uint32_t *)(base + DCSPDRV_REG_IRC_o);
+    st->sr = *(volatile uint32_t *)(base + DCSPDRV_REG_SR_o);
+    /* modular difference survives counter wraparound */
+    st->pos += (int32_t)(raw - st->raw);
+    st->raw = raw;
+
+    if (req & (1u << axis)) {
+      for (k = 0; k < MOTOR_IRC_HIST_LEN; k++)
+        mi->hist_pos[axis][k] -= st->pos;
+      st->pos = 0;
+    }
+
+    mi->hist_pos[axis][idx] = st->pos;
+    if (dt_ns > 0)
+      st->vel = (st->pos - mi->hist_pos[axis][old]) * 1000000000 / dt_ns;
+  }
+  mi->hist_ns[idx] = now_ns;
+  mi->hist_idx = idx;
+  mi->work.time_ns = now_ns;
+  mi->work.samples = have;
+
+  /* publish, readers retry while seq is odd */
+  __atomic_store_n(&mi->seq, mi->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  mi->snap = mi->work;
+  __atomic_store_n(&mi->seq, mi->seq + 1, __ATOMIC_RELEASE);
+}
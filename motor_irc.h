@@ -0,0 +1,101 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  motor_irc.h      - DC motor IRC encoder sampling and velocity
+                     estimation
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef MOTOR_IRC_H
+#define MOTOR_IRC_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOTOR_IRC_AXES       2
+
+/* Position history for velocity, must be power of two */
+#define MOTOR_IRC_HIST_LEN   32
+
+typedef struct motor_irc_state_t {
+  int64_t  pos;           /* IRC counts since start, unwrapped */
+  int32_t  vel;           /* counts per second */
+  uint32_t raw;           /* last DCSPDRV_REG_IRC_o value */
+  uint32_t sr;            /* last DCSPDRV_REG_SR_o value */
+} motor_irc_state_t;
+
+typedef struct motor_irc_snapshot_t {
+  uint64_t          time_ns;     /* CLOCK_MONOTONIC of the sample */
+  unsigned long     samples;
+  motor_irc_state_t axis[MOTOR_IRC_AXES];
+} motor_irc_snapshot_t;
+
+/*
+  The sampler is the only writer of the snapshot. Sequence counter is
+  odd while the snapshot is updated, readers retry when it was odd
+  or changed during their copy, so they never block the sampler.
+*/
+typedef struct motor_irc_t {
+  unsigned char       *dcspdrv_mem_base[MOTOR_IRC_AXES];
+  long                 period_ns;
+  int                  vel_win;        /* samples over which velocity is taken */
+  int                  stop;
+  int                  running;
+  int                  realtime;
+  unsigned             reset_req;      /* axis mask, served by the sampler */
+  pthread_t            thread;
+  unsigned             hist_idx;
+  int64_t              hist_pos[MOTOR_IRC_AXES][MOTOR_IRC_HIST_LEN];
+  uint64_t             hist_ns[MOTOR_IRC_HIST_LEN];
+  motor_irc_snapshot_t work;
+  unsigned             seq;
+  motor_irc_snapshot_t snap;
+} motor_irc_t;
+
+/*
+  Prepares sampling of both DCSPDRV blocks, a NULL base leaves the
+  axis unused. Velocity is the position difference over vel_ms taken
+  from sample timestamps, so wakeup jitter does not show up as noise.
+*/
+int motor_irc_init(motor_irc_t *mi, unsigned char *dcspdrv0_mem_base,
+                   unsigned char *dcspdrv1_mem_base, int rate_hz, int vel_ms);
+
+/*
+  Runs sampling thread at rate_hz, SCHED_FIFO when rt_priority is
+  nonzero and permitted.
+*/
+int motor_irc_start(motor_irc_t *mi, int rt_priority);
+
+void motor_irc_stop(motor_irc_t *mi);
+
+/* Takes one sample and publishes it, for callers with own loop */
+void motor_irc_sample(motor_irc_t *mi, uint64_t now_ns);
+
+/* Consistent copy of the latest sample of both axes */
+static inline void motor_irc_read(motor_irc_t *mi, motor_irc_snapshot_t *snap)
+{
+  unsigned seq;
+
+  do {
+    while ((seq = __atomic_load_n(&mi->seq, __ATOMIC_ACQUIRE)) & 1)
+      ;
+    *snap = mi->snap;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (seq != __atomic_load_n(&mi->seq, __ATOMIC_RELAXED));
+}
+
+/* Zeroes unwrapped position of the axis */
+void motor_irc_reset(motor_irc_t *mi, int axis);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*MOTOR_IRC_H*/
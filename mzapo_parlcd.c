@@ -17,11 +17,48 @@
 //#define HX8357_B
 //#define ILI9481
 
+#include <sched.h>
 #include <stdint.h>
 #include <time.h>
 
 #include "mzapo_parlcd.h"
+#include "mzapo_phys.h"
 #include "mzapo_regs.h"
+#include "mzapo_sim.h"
+
+/* The ring lives only in simulated windows, never in register space */
+static inline int parlcd_sim_mapped(unsigned char *parlcd_mem_base)
+{
+  return __atomic_load_n(&mzapo_sim_active, __ATOMIC_ACQUIRE) &&
+         (map_phys_mem_backend(parlcd_mem_base) == MAP_PHYS_BACKEND_SIM);
+}
+
+static inline int parlcd_sim_attached(unsigned char *parlcd_mem_base)
+{
+  parlcd_sim_ring_t *ring = (parlcd_sim_ring_t *)(parlcd_mem_base + PARLCD_SIM_RING_o);
+
+  return parlcd_sim_mapped(parlcd_mem_base) &&
+         __atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE);
+}
+
+/* Queue the word for the emulator, waits while its ring is full */
+static void parlcd_sim_push(unsigned char *parlcd_mem_base, uint32_t word)
+{
+  parlcd_sim_ring_t *ring = (parlcd_sim_ring_t *)(parlcd_mem_base + PARLCD_SIM_RING_o);
+  uint32_t head = ring->head;
+
+  if (!__atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE))
+    return;
+
+  while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= PARLCD_SIM_RING_LEN) {
+    if (!__atomic_load_n(&ring->consumer, __ATOMIC_ACQUIRE))
+      return;
+    sched_yield();
+  }
+
+  ring->entry[head % PARLCD_SIM_RING_LEN] = word;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
 
 void parlcd_write_cr(unsigned char *parlcd_mem_base, uint16_t data)
 {
@@ -31,16 +68,64 @@ void parlcd_write_cr(unsigned char *parlcd_mem_base, uint16_t data)
 void parlcd_write_cmd(unsigned char *parlcd_mem_base, uint16_t cmd)
 {
   *(volatile uint16_t*)(parlcd_mem_base + PARLCD_REG_CMD_o) = cmd;
+  if (parlcd_sim_mapped(parlcd_mem_base))
+    parlcd_sim_push(parlcd_mem_base, PARLCD_SIM_CMD_m | cmd);
 }
 
 void parlcd_write_data(unsigned char *parlcd_mem_base, uint16_t data)
 {
   *(volatile uint16_t*)(parlcd_mem_base + PARLCD_REG_DATA_o) = data;
+  if (parlcd_sim_mapped(parlcd_mem_base))
+    parlcd_sim_push(parlcd_mem_base, data);
 }
 
 void parlcd_write_data2x(unsigned char *parlcd_mem_base, uint32_t data)
 {
   *(volatile uint32_t*)(parlcd_mem_base + PARLCD_REG_DATA_o) = data;
+  if (parlcd_sim_mapped(parlcd_mem_base)) {
+    parlcd_sim_push(parlcd_mem_base, data & 0xffff);
+    parlcd_sim_push(parlcd_mem_base, data >> 16);
+  }
+}
+
+void parlcd_set_window(unsigned char *parlcd_mem_base,
+                       int x0, int y0, int x1, int y1)
+{
+  parlcd_write_cmd(parlcd_mem_base, 0x2A); // Column address set
+  parlcd_write_data(parlcd_mem_base, x0 >> 8);
+  parlcd_write_data(parlcd_mem_base, x0 & 0xff);
+  parlcd_write_data(parlcd_mem_base, x1 >> 8);
+  parlcd_write_data(parlcd_mem_base, x1 & 0xff);
+
+  parlcd_write_cmd(parlcd_mem_base, 0x2B); // Page address set
+  parlcd_write_data(parlcd_mem_base, y0 >> 8);
+  parlcd_write_data(parlcd_mem_base, y0 & 0xff);
+  parlcd_write_data(parlcd_mem_base, y1 >> 8);
+  parlcd_write_data(parlcd_mem_base, y1 & 0xff);
+}
+
+void parlcd_write_pixels(unsigned char *parlcd_mem_base,
+                         const uint16_t *pixels, size_t count)
+{
+  volatile uint32_t *data2x = (volatile uint32_t*)(parlcd_mem_base + PARLCD_REG_DATA_o);
+
+  if (parlcd_sim_attached(parlcd_mem_base)) {
+    for (; count >= 2; count -= 2, pixels += 2) {
+      *data2x = pixels[0] | ((uint32_t)pixels[1] << 16);
+      parlcd_sim_push(parlcd_mem_base, pixels[0]);
+      parlcd_sim_push(parlcd_mem_base, pixels[1]);
+    }
+    if (count)
+      parlcd_write_data(parlcd_mem_base, pixels[0]);
+    return;
+  }
+
+  /* the first pixel of the pair travels in the lower halfword */
+  for (; count >= 2; count -= 2, pixels += 2)
+    *data2x = pixels[0] | ((uint32_t)pixels[1] << 16);
+
+  if (count)
+    parlcd_write_data(parlcd_mem_base, pixels[0]);
 }
 
 void parlcd_delay(int msec)
@@ -50,259 +135,225 @@ void parlcd_delay(int msec)
   clock_nanosleep(CLOCK_MONOTONIC, 0, &wait_delay, NULL);
 }
 
-void parlcd_hx8357_init(unsigned char *parlcd_mem_base)
-{
-  // toggle RST low to reset
 /*
-    digitalWrite(_rst, HIGH);
-    parlcd_delay(50);
-    digitalWrite(_rst, LOW);
-    parlcd_delay(10);
-    digitalWrite(_rst, HIGH);
-    parlcd_delay(10);
+  Controller initialization sequences. Each entry is a command byte,
+  a byte with the parameter count optionally ORed with PARLCD_SEQ_DELAY_m,
+  the parameters and, with the flag, a delay in milliseconds to wait
+  after the command.
+
+  Delays follow the controller datasheets. Software reset of a panel
+  which is awake needs 120 ms before Sleep Out may be sent, the init
+  can run on a display left on by a previous application, so that gap
+  is kept from the reset in every table. Sleep out waits as before,
+  MADCTL, inversion and display on need no settling time.
 */
-    parlcd_write_cmd(parlcd_mem_base, 0x1);
-    parlcd_delay(30);
+#define PARLCD_SEQ_DELAY_m  0x80
+
+static const uint8_t parlcd_seq_ili9481[] = {
+  0x01, PARLCD_SEQ_DELAY_m | 0, 120,    // Software reset
+  0x11, PARLCD_SEQ_DELAY_m | 0, 20,     // Sleep out
+  0xD0, 3, 0x07, 0x42, 0x18,
+  0xD1, 3, 0x00, 0x07, 0x10,
+  0xD2, 2, 0x01, 0x02,
+  0xC0, 5, 0x10, 0x3B, 0x00, 0x02, 0x11,
+  0xC5, 1, 0x03,
+  0xC8, 12, 0x00, 0x32, 0x36, 0x45, 0x06, 0x16,
+            0x37, 0x75, 0x77, 0x54, 0x0C, 0x00,
+  0x36, 1, 0x28,                        // MADCTL, 0x0A for portrait
+  0x3A, 1, 0x55,                        // 16 bits per pixel
+  0x2B, 4, 0x00, 0x00, 0x01, 0x3F,
+  0x2A, PARLCD_SEQ_DELAY_m | 4, 0x00, 0x00, 0x01, 0xDF, 100,
+  0x29, 0,                              // Display on
+};
+
+static const uint8_t parlcd_seq_hx8357_b[] = {
+  0x01, PARLCD_SEQ_DELAY_m | 0, 120,    // Software reset
+  0x11, PARLCD_SEQ_DELAY_m | 0, 20,     // Sleep out
+  0xD0, 3, 0x07, 0x42, 0x18,
+  0xD1, 3, 0x00, 0x07, 0x10,
+  0xD2, 2, 0x01, 0x02,
+  0xC0, 5, 0x10, 0x3B, 0x00, 0x02, 0x11,
+  0xC5, 1, 0x08,
+  0xC8, 12, 0x00, 0x32, 0x36, 0x45, 0x06, 0x16,
+            0x37, 0x75, 0x77, 0x54, 0x0C, 0x00,
+  0x36, 1, 0x0a,                        // MADCTL
+  0x3A, 1, 0x55,                        // 16 bits per pixel
+  0x2A, 4, 0x00, 0x00, 0x01, 0x3F,
+  0x2B, PARLCD_SEQ_DELAY_m | 4, 0x00, 0x00, 0x01, 0xDF, 100,
+  0x29, 0,                              // Display on
+};
+
+static const uint8_t parlcd_seq_hx8357_c[] = {
+  0x01, PARLCD_SEQ_DELAY_m | 0, 120,    // Software reset
+  0xB9, PARLCD_SEQ_DELAY_m | 3, 0xFF, 0x83, 0x57, 50, // Enable extension command
+  0xB6, 1, 0x52,                        // Set VCOM voltage, 0x52 for HSD 3.0"
+  0x11, PARLCD_SEQ_DELAY_m | 0, 120,    // Sleep off
+  0x35, 1, 0x00,                        // Tearing effect on
+  0x3A, 1, 0x55,                        // Interface pixel format, 16 bits per pixel
+  0xB1, 6, 0x00, 0x15, 0x0D, 0x0D, 0x83, 0x48, // Power control
+  0xC0, 6, 0x24, 0x24, 0x01, 0x3C, 0xC8, 0x08,
+  0xB4, 7, 0x02, 0x40, 0x00, 0x2A, 0x2A, 0x0D, 0x4F, // Display cycle
+  0xE0, 34, 0x00, 0x15, 0x1D, 0x2A, 0x31, 0x42, 0x4C, 0x53, // Gamma curve
+            0x45, 0x40, 0x3B, 0x32, 0x2E, 0x28, 0x24, 0x03,
+            0x00, 0x15, 0x1D, 0x2A, 0x31, 0x42, 0x4C, 0x53,
+            0x45, 0x40, 0x3B, 0x32, 0x2E, 0x28, 0x24, 0x03,
+            0x00, 0x01,
+  0x36, 1, 0xE8,                        // MADCTL Memory access control
+  0x21, 0,                              // Display inversion on
+  0x29, 0,                              // Display on
+};
+
+void parlcd_write_seq(unsigned char *parlcd_mem_base, const uint8_t *seq, size_t len)
+{
+  const uint8_t *end = seq + len;
+  int flags;
+  int delay;
+  int cnt;
+
+  while (seq < end) {
+    parlcd_write_cmd(parlcd_mem_base, *seq++);
+    flags = *seq++;
+    cnt = flags & ~PARLCD_SEQ_DELAY_m;
+    while (cnt--)
+      parlcd_write_data(parlcd_mem_base, *seq++);
+    /* the delay byte follows whenever flagged, zero included */
+    if (flags & PARLCD_SEQ_DELAY_m) {
+      delay = *seq++;
+      if (delay)
+        parlcd_delay(delay);
+    }
+  }
+}
 
-#if defined(ILI9481)
-// Configure ILI9481 display
-
-    parlcd_write_cmd(parlcd_mem_base, 0x11);
-    parlcd_delay(20);
-    parlcd_write_cmd(parlcd_mem_base, 0xD0);
-    parlcd_write_data(parlcd_mem_base, 0x07);
-    parlcd_write_data(parlcd_mem_base, 0x42);
-    parlcd_write_data(parlcd_mem_base, 0x18);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xD1);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x07);
-    parlcd_write_data(parlcd_mem_base, 0x10);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xD2);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0x02);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC0);
-    parlcd_write_data(parlcd_mem_base, 0x10);
-    parlcd_write_data(parlcd_mem_base, 0x3B);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x02);
-    parlcd_write_data(parlcd_mem_base, 0x11);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC5);
-    parlcd_write_data(parlcd_mem_base, 0x03);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC8);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x32);
-    parlcd_write_data(parlcd_mem_base, 0x36);
-    parlcd_write_data(parlcd_mem_base, 0x45);
-    parlcd_write_data(parlcd_mem_base, 0x06);
-    parlcd_write_data(parlcd_mem_base, 0x16);
-    parlcd_write_data(parlcd_mem_base, 0x37);
-    parlcd_write_data(parlcd_mem_base, 0x75);
-    parlcd_write_data(parlcd_mem_base, 0x77);
-    parlcd_write_data(parlcd_mem_base, 0x54);
-    parlcd_write_data(parlcd_mem_base, 0x0C);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x36);
-    //parlcd_write_data(parlcd_mem_base, 0x0A);
-    parlcd_write_data(parlcd_mem_base, 0x28);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x3A);
-    parlcd_write_data(parlcd_mem_base, 0x55);
-
-    //parlcd_write_cmd(parlcd_mem_base, 0x2A);
-    parlcd_write_cmd(parlcd_mem_base,  0x2B);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0x3F);
-
-    //parlcd_write_cmd(parlcd_mem_base, 0x2B);
-    parlcd_write_cmd(parlcd_mem_base,  0x2A);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0xDF);
-
-    parlcd_delay(120);
-    parlcd_write_cmd(parlcd_mem_base, 0x29);
-
-    parlcd_delay(25);
+void parlcd_init_controller(unsigned char *parlcd_mem_base, int controller)
+{
+  switch (controller) {
+    case PARLCD_CTRL_ILI9481:
+      parlcd_write_seq(parlcd_mem_base, parlcd_seq_ili9481,
+                       sizeof(parlcd_seq_ili9481));
+      break;
+    case PARLCD_CTRL_HX8357_B:
+      parlcd_write_seq(parlcd_mem_base, parlcd_seq_hx8357_b,
+                       sizeof(parlcd_seq_hx8357_b));
+      break;
+    default:
+      parlcd_write_seq(parlcd_mem_base, parlcd_seq_hx8357_c,
+                       sizeof(parlcd_seq_hx8357_c));
+      break;
+  }
+}
 
+int parlcd_default_controller(void)
+{
+#if defined(ILI9481)
+  return PARLCD_CTRL_ILI9481;
 #elif defined(HX8357_B)
-// Configure HX8357-B display
-    parlcd_write_cmd(parlcd_mem_base, 0x11);
-    parlcd_delay(20);
-    parlcd_write_cmd(parlcd_mem_base, 0xD0);
-    parlcd_write_data(parlcd_mem_base, 0x07);
-    parlcd_write_data(parlcd_mem_base, 0x42);
-    parlcd_write_data(parlcd_mem_base, 0x18);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xD1);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x07);
-    parlcd_write_data(parlcd_mem_base, 0x10);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xD2);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0x02);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC0);
-    parlcd_write_data(parlcd_mem_base, 0x10);
-    parlcd_write_data(parlcd_mem_base, 0x3B);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x02);
-    parlcd_write_data(parlcd_mem_base, 0x11);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC5);
-    parlcd_write_data(parlcd_mem_base, 0x08);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC8);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x32);
-    parlcd_write_data(parlcd_mem_base, 0x36);
-    parlcd_write_data(parlcd_mem_base, 0x45);
-    parlcd_write_data(parlcd_mem_base, 0x06);
-    parlcd_write_data(parlcd_mem_base, 0x16);
-    parlcd_write_data(parlcd_mem_base, 0x37);
-    parlcd_write_data(parlcd_mem_base, 0x75);
-    parlcd_write_data(parlcd_mem_base, 0x77);
-    parlcd_write_data(parlcd_mem_base, 0x54);
-    parlcd_write_data(parlcd_mem_base, 0x0C);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x36);
-    parlcd_write_data(parlcd_mem_base, 0x0a);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x3A);
-    parlcd_write_data(parlcd_mem_base, 0x55);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x2A);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0x3F);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x2B);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0xDF);
-
-    parlcd_delay(120);
-    parlcd_write_cmd(parlcd_mem_base, 0x29);
-
-    parlcd_delay(25);
-
+  return PARLCD_CTRL_HX8357_B;
 #else
-// HX8357-C display initialisation
-
-    parlcd_write_cmd(parlcd_mem_base, 0xB9); // Enable extension command
-    parlcd_write_data(parlcd_mem_base, 0xFF);
-    parlcd_write_data(parlcd_mem_base, 0x83);
-    parlcd_write_data(parlcd_mem_base, 0x57);
-    parlcd_delay(50);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xB6); //Set VCOM voltage
-    //parlcd_write_data(parlcd_mem_base, 0x2C);    //0x52 for HSD 3.0"
-    parlcd_write_data(parlcd_mem_base, 0x52);    //0x52 for HSD 3.0"
-
-    parlcd_write_cmd(parlcd_mem_base, 0x11); // Sleep off
-    parlcd_delay(200);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x35); // Tearing effect on
-    parlcd_write_data(parlcd_mem_base, 0x00);    // Added parameter
-
-    parlcd_write_cmd(parlcd_mem_base, 0x3A); // Interface pixel format
-    parlcd_write_data(parlcd_mem_base, 0x55);    // 16 bits per pixel
-
-    //parlcd_write_cmd(parlcd_mem_base, 0xCC); // Set panel characteristic
-    //parlcd_write_data(parlcd_mem_base, 0x09);    // S960>S1, G1>G480, R-G-B, normally black
-
-    //parlcd_write_cmd(parlcd_mem_base, 0xB3); // RGB interface
-    //parlcd_write_data(parlcd_mem_base, 0x43);
-    //parlcd_write_data(parlcd_mem_base, 0x00);
-    //parlcd_write_data(parlcd_mem_base, 0x06);
-    //parlcd_write_data(parlcd_mem_base, 0x06);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xB1); // Power control
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x15);
-    parlcd_write_data(parlcd_mem_base, 0x0D);
-    parlcd_write_data(parlcd_mem_base, 0x0D);
-    parlcd_write_data(parlcd_mem_base, 0x83);
-    parlcd_write_data(parlcd_mem_base, 0x48);
-
-
-    parlcd_write_cmd(parlcd_mem_base, 0xC0); // Does this do anything?
-    parlcd_write_data(parlcd_mem_base, 0x24);
-    parlcd_write_data(parlcd_mem_base, 0x24);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-    parlcd_write_data(parlcd_mem_base, 0x3C);
-    parlcd_write_data(parlcd_mem_base, 0xC8);
-    parlcd_write_data(parlcd_mem_base, 0x08);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xB4); // Display cycle
-    parlcd_write_data(parlcd_mem_base, 0x02);
-    parlcd_write_data(parlcd_mem_base, 0x40);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x2A);
-    parlcd_write_data(parlcd_mem_base, 0x2A);
-    parlcd_write_data(parlcd_mem_base, 0x0D);
-    parlcd_write_data(parlcd_mem_base, 0x4F);
-
-    parlcd_write_cmd(parlcd_mem_base, 0xE0); // Gamma curve
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x15);
-    parlcd_write_data(parlcd_mem_base, 0x1D);
-    parlcd_write_data(parlcd_mem_base, 0x2A);
-    parlcd_write_data(parlcd_mem_base, 0x31);
-    parlcd_write_data(parlcd_mem_base, 0x42);
-    parlcd_write_data(parlcd_mem_base, 0x4C);
-    parlcd_write_data(parlcd_mem_base, 0x53);
-    parlcd_write_data(parlcd_mem_base, 0x45);
-    parlcd_write_data(parlcd_mem_base, 0x40);
-    parlcd_write_data(parlcd_mem_base, 0x3B);
-    parlcd_write_data(parlcd_mem_base, 0x32);
-    parlcd_write_data(parlcd_mem_base, 0x2E);
-    parlcd_write_data(parlcd_mem_base, 0x28);
-
-    parlcd_write_data(parlcd_mem_base, 0x24);
-    parlcd_write_data(parlcd_mem_base, 0x03);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x15);
-    parlcd_write_data(parlcd_mem_base, 0x1D);
-    parlcd_write_data(parlcd_mem_base, 0x2A);
-    parlcd_write_data(parlcd_mem_base, 0x31);
-    parlcd_write_data(parlcd_mem_base, 0x42);
-    parlcd_write_data(parlcd_mem_base, 0x4C);
-    parlcd_write_data(parlcd_mem_base, 0x53);
-    parlcd_write_data(parlcd_mem_base, 0x45);
-    parlcd_write_data(parlcd_mem_base, 0x40);
-    parlcd_write_data(parlcd_mem_base, 0x3B);
-    parlcd_write_data(parlcd_mem_base, 0x32);
-
-    parlcd_write_data(parlcd_mem_base, 0x2E);
-    parlcd_write_data(parlcd_mem_base, 0x28);
-    parlcd_write_data(parlcd_mem_base, 0x24);
-    parlcd_write_data(parlcd_mem_base, 0x03);
-    parlcd_write_data(parlcd_mem_base, 0x00);
-    parlcd_write_data(parlcd_mem_base, 0x01);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x36); // MADCTL Memory access control
-    //parlcd_write_data(parlcd_mem_base, 0x48);
-    parlcd_write_data(parlcd_mem_base, 0xE8);
-    parlcd_delay(20);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x21); //Display inversion on
-    parlcd_delay(20);
-
-    parlcd_write_cmd(parlcd_mem_base, 0x29); // Display on
-
-    parlcd_delay(120);
+  return PARLCD_CTRL_HX8357_C;
 #endif
 }
+
+void parlcd_hx8357_init(unsigned char *parlcd_mem_base)
+{
+  parlcd_init_controller(parlcd_mem_base, parlcd_default_controller());
+}
+
+/* Returns parameters of the first cmd in the sequence or NULL */
+static const uint8_t *parlcd_seq_find(const uint8_t *seq, size_t len, uint8_t cmd)
+{
+  const uint8_t *end = seq + len;
+  int cnt;
+
+  while (seq < end) {
+    if (*seq == cmd)
+      return seq + 2;
+    cnt = seq[1] & ~PARLCD_SEQ_DELAY_m;
+    seq += 2 + cnt + ((seq[1] & PARLCD_SEQ_DELAY_m)? 1: 0);
+  }
+
+  return NULL;
+}
+
+uint8_t parlcd_controller_madctl(int controller)
+{
+  const uint8_t *p;
+
+  switch (controller) {
+    case PARLCD_CTRL_ILI9481:
+      p = parlcd_seq_find(parlcd_seq_ili9481, sizeof(parlcd_seq_ili9481), 0x36);
+      break;
+    case PARLCD_CTRL_HX8357_B:
+      p = parlcd_seq_find(parlcd_seq_hx8357_b, sizeof(parlcd_seq_hx8357_b), 0x36);
+      break;
+    default:
+      p = parlcd_seq_find(parlcd_seq_hx8357_c, sizeof(parlcd_seq_hx8357_c), 0x36);
+      break;
+  }
+
+  return p? *p: 0;
+}
+
+static void parlcd_write_data16(unsigned char *parlcd_mem_base, int val)
+{
+  parlcd_write_data(parlcd_mem_base, val >> 8);
+  parlcd_write_data(parlcd_mem_base, val & 0xff);
+}
+
+/* Sends the vertical scrolling start address for the current offset */
+static void parlcd_scroll_vsp(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc)
+{
+  int tfa, off;
+
+  /* memory rows run the other way, the start address moves back */
+  if (sc->reverse) {
+    tfa = PARLCD_SCROLL_LINES - sc->start - sc->len;
+    off = sc->offset? sc->len - sc->offset: 0;
+  } else {
+    tfa = sc->start;
+    off = sc->offset;
+  }
+
+  parlcd_write_cmd(parlcd_mem_base, 0x37); // Vertical scrolling start address
+  parlcd_write_data16(parlcd_mem_base, tfa + off);
+}
+
+int parlcd_scroll_init(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc,
+                       uint8_t madctl, int start, int len)
+{
+  int tfa;
+
+  if (start < 0 || len <= 0 || start + len > PARLCD_SCROLL_LINES)
+    return -1;
+
+  sc->axis = (madctl & PARLCD_MADCTL_MV_m)? PARLCD_SCROLL_X: PARLCD_SCROLL_Y;
+  sc->reverse = (madctl & PARLCD_MADCTL_MY_m)? 1: 0;
+  sc->start = start;
+  sc->len = len;
+  sc->offset = 0;
+
+  /* top and bottom fixed areas are counted in memory rows */
+  tfa = sc->reverse? PARLCD_SCROLL_LINES - start - len: start;
+
+  parlcd_write_cmd(parlcd_mem_base, 0x33); // Vertical scrolling definition
+  parlcd_write_data16(parlcd_mem_base, tfa);
+  parlcd_write_data16(parlcd_mem_base, len);
+  parlcd_write_data16(parlcd_mem_base, PARLCD_SCROLL_LINES - tfa - len);
+
+  parlcd_scroll_vsp(parlcd_mem_base, sc);
+
+  return 0;
+}
+
+void parlcd_scroll_by(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc,
+                      int lines)
+{
+  sc->offset = (sc->offset + lines % sc->len + sc->len) % sc->len;
+  parlcd_scroll_vsp(parlcd_mem_base, sc);
+}
+
+void parlcd_scroll_off(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc)
+{
+  sc->offset = 0;
+  parlcd_write_cmd(parlcd_mem_base, 0x13); // Normal display mode on
+}
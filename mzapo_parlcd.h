@@ -15,8 +15,13 @@
 #ifndef MZAPO_PARLCD_H
 #define MZAPO_PARLCD_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+/* Panel geometry for the landscape orientation set by parlcd_hx8357_init */
+#define PARLCD_WIDTH   480
+#define PARLCD_HEIGHT  320
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,10 +34,79 @@ void parlcd_write_data(unsigned char *parlcd_mem_base, uint16_t data);
 
 void parlcd_write_data2x(unsigned char *parlcd_mem_base, uint32_t data);
 
+/* Limits following memory writes to columns x0..x1 and pages y0..y1 */
+void parlcd_set_window(unsigned char *parlcd_mem_base,
+                       int x0, int y0, int x1, int y1);
+
+/* Streams count RGB565 pixels, two per 32-bit data register store */
+void parlcd_write_pixels(unsigned char *parlcd_mem_base,
+                         const uint16_t *pixels, size_t count);
+
 void parlcd_delay(int msec);
 
+#define PARLCD_CTRL_HX8357_C  0
+#define PARLCD_CTRL_HX8357_B  1
+#define PARLCD_CTRL_ILI9481   2
+
+/* Streams command sequence table, see mzapo_parlcd.c for its format */
+void parlcd_write_seq(unsigned char *parlcd_mem_base, const uint8_t *seq, size_t len);
+
+void parlcd_init_controller(unsigned char *parlcd_mem_base, int controller);
+
+/* Initializes controller selected at compile time, HX8357-C by default */
 void parlcd_hx8357_init(unsigned char *parlcd_mem_base);
 
+/* Controller parlcd_hx8357_init selects */
+int parlcd_default_controller(void);
+
+/* MADCTL value the controller init sequence sets */
+uint8_t parlcd_controller_madctl(int controller);
+
+#define PARLCD_MADCTL_MY_m  0x80  /* memory row order reversed */
+#define PARLCD_MADCTL_MX_m  0x40  /* memory column order reversed */
+#define PARLCD_MADCTL_MV_m  0x20  /* rows and columns exchanged */
+
+/*
+  Hardware scrolling rotates the panel memory rows (0x33 vertical
+  scrolling definition, 0x37 start address) so no pixel is resent.
+  Memory rows are the long panel side, PARLCD_SCROLL_LINES of them.
+  The landscape MADCTL values (0xE8, 0x28) exchange rows and columns
+  so the area scrolls along logical x there, 0x0a keeps it along y.
+  Lines are numbered in logical coordinates along that axis.
+*/
+#define PARLCD_SCROLL_LINES  480
+
+#define PARLCD_SCROLL_X  0
+#define PARLCD_SCROLL_Y  1
+
+typedef struct parlcd_scroll_t {
+  int axis;     /* PARLCD_SCROLL_X or PARLCD_SCROLL_Y */
+  int reverse;  /* MADCTL_MY, logical lines run against memory rows */
+  int start;    /* first logical line of the scrolled area */
+  int len;      /* lines in the area */
+  int offset;   /* lines the content moved towards start, 0..len-1 */
+} parlcd_scroll_t;
+
+/*
+  Defines the scrolled area start..start+len-1 for the given MADCTL,
+  lines outside it stay fixed. Returns -1 for area out of the panel.
+*/
+int parlcd_scroll_init(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc,
+                       uint8_t madctl, int start, int len);
+
+/* Moves the content by lines towards the area start, negative back */
+void parlcd_scroll_by(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc,
+                      int lines);
+
+/* Returns to normal display mode (0x13), memory shows unrotated */
+void parlcd_scroll_off(unsigned char *parlcd_mem_base, parlcd_scroll_t *sc);
+
+/* Logical memory line shown at the area line i (0 = area start) */
+static inline int parlcd_scroll_mem_line(const parlcd_scroll_t *sc, int i)
+{
+  return sc->start + (i + sc->offset) % sc->len;
+}
+
 
 #ifdef __cplusplus
 } /* extern "C"*/
@@ -12,45 +12,321 @@
 
  *******************************************************************/
 
-#define _POSIX_C_SOURCE 200112L
+#define _POSIX_C_SOURCE 200809L
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "mzapo_phys.h"
+#include "mzapo_regs.h"
+#include "mzapo_sim.h"
+
+#define MAP_PHYS_CACHE_MAX 32
+
+typedef struct map_phys_entry_t {
+  unsigned char *mm;
+  off_t          base;      /* page aligned physical address */
+  size_t         size;
+  int            backend;
+  int            cached;
+  int            refcnt;
+} map_phys_entry_t;
 
 const char *map_phys_memdev="/dev/mem";
 
+static pthread_mutex_t map_phys_lock = PTHREAD_MUTEX_INITIALIZER;
+static map_phys_entry_t map_phys_cache[MAP_PHYS_CACHE_MAX];
+static int map_phys_cache_cnt;
+static int map_phys_fd_devmem[2] = {-1, -1};
+static int map_phys_fd_sim = -1;
+
+static int map_phys_backend_sel = -1;
+static const char *map_phys_sim_file;
+
+int mzapo_sim_active;
+
+int map_phys_set_backend(int backend, const char *sim_file)
+{
+  if ((backend != MAP_PHYS_BACKEND_DEVMEM) && (backend != MAP_PHYS_BACKEND_SIM))
+    return -1;
+
+  map_phys_backend_sel = backend;
+  map_phys_sim_file = sim_file;
+
+  return 0;
+}
+
+int map_phys_get_backend(void)
+{
+  const char *env;
+
+  if (map_phys_backend_sel >= 0)
+    return map_phys_backend_sel;
+
+  env = getenv(MZAPO_SIM_ENV);
+  if ((env == NULL) || !*env || !strcmp(env, "0"))
+    map_phys_backend_sel = MAP_PHYS_BACKEND_DEVMEM;
+  else
+    map_phys_backend_sel = MAP_PHYS_BACKEND_SIM;
+
+  return map_phys_backend_sel;
+}
+
+static const char *map_phys_sim_fname(void)
+{
+  const char *env = getenv(MZAPO_SIM_ENV);
+
+  if (map_phys_sim_file != NULL)
+    return map_phys_sim_file;
+
+  if ((env == NULL) || !*env || !strcmp(env, "0") || !strcmp(env, "1"))
+    return MZAPO_SIM_DEFAULT_FILE;
+
+  return env;
+}
+
+static int map_phys_sim_open(void)
+{
+  const char *fname = map_phys_sim_fname();
+  struct stat st;
+  int fd;
+
+  fd = open(fname, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+  if (fd < 0) {
+    fprintf(stderr, "cannot open %s\n", fname);
+    return -1;
+  }
+
+  /* new file reads as zeroed registers */
+  if ((fstat(fd, &st) < 0) ||
+      ((st.st_size < MZAPO_SIM_PHYS_SIZE) && (ftruncate(fd, MZAPO_SIM_PHYS_SIZE) < 0))) {
+    fprintf(stderr, "cannot size %s\n", fname);
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/* Descriptor shared by all mappings of the backend and caching mode */
+static int map_phys_get_fd(int backend, int opt_cached)
+{
+  int *pfd = backend == MAP_PHYS_BACKEND_SIM? &map_phys_fd_sim:
+             &map_phys_fd_devmem[opt_cached? 1: 0];
+
+  if (*pfd >= 0)
+    return *pfd;
+
+  if (backend == MAP_PHYS_BACKEND_SIM) {
+    *pfd = map_phys_sim_open();
+  } else {
+    *pfd = open(map_phys_memdev, O_RDWR | O_CLOEXEC | (!opt_cached? O_SYNC: 0));
+    if (*pfd < 0)
+      fprintf(stderr, "cannot open %s\n", map_phys_memdev);
+  }
+
+  return *pfd;
+}
+
+static void map_phys_close_unused(void)
+{
+  if (map_phys_cache_cnt)
+    return;
+
+  if (map_phys_fd_sim >= 0)
+    close(map_phys_fd_sim);
+  if (map_phys_fd_devmem[0] >= 0)
+    close(map_phys_fd_devmem[0]);
+  if (map_phys_fd_devmem[1] >= 0)
+    close(map_phys_fd_devmem[1]);
+
+  map_phys_fd_sim = -1;
+  map_phys_fd_devmem[0] = -1;
+  map_phys_fd_devmem[1] = -1;
+}
+
 void *map_phys_address(off_t region_base, size_t region_size, int opt_cached)
 {
   unsigned long mem_window_size;
   unsigned long pagesize;
   unsigned char *mm;
-  unsigned char *mem;
+  unsigned char *mem = NULL;
+  map_phys_entry_t *ent;
+  off_t window_base;
+  off_t map_offs;
+  int backend;
   int fd;
+  int i;
 
-  fd = open(map_phys_memdev, O_RDWR | (!opt_cached? O_SYNC: 0));
-  if (fd < 0) {
-    fprintf(stderr, "cannot open %s\n", map_phys_memdev);
-    return NULL;
-  }
+  opt_cached = opt_cached? 1: 0;
+  backend = map_phys_get_backend();
 
   pagesize=sysconf(_SC_PAGESIZE);
 
+  window_base = region_base & ~(pagesize-1);
   mem_window_size = ((region_base & (pagesize-1)) + region_size + pagesize-1) & ~(pagesize-1);
 
+  if (backend == MAP_PHYS_BACKEND_SIM) {
+    if ((region_base < MZAPO_SIM_PHYS_BASE) ||
+        (region_base + region_size > MZAPO_SIM_PHYS_BASE + MZAPO_SIM_PHYS_SIZE)) {
+      fprintf(stderr, "region 0x%lx is not simulated\n", (unsigned long)region_base);
+      return NULL;
+    }
+    map_offs = window_base - MZAPO_SIM_PHYS_BASE;
+  } else {
+    map_offs = window_base;
+  }
+
+  pthread_mutex_lock(&map_phys_lock);
+
+  /* reuse window which already covers the region */
+  for (i = 0; i < map_phys_cache_cnt; i++) {
+    ent = &map_phys_cache[i];
+    if ((ent->backend == backend) && (ent->cached == opt_cached) &&
+        (ent->base <= window_base) &&
+        (window_base + mem_window_size <= ent->base + ent->size)) {
+      ent->refcnt++;
+      mem = ent->mm + (region_base - ent->base);
+      goto unlock;
+    }
+  }
+
+  if (map_phys_cache_cnt >= MAP_PHYS_CACHE_MAX) {
+    fprintf(stderr, "too many mapped regions\n");
+    goto unlock;
+  }
+
+  fd = map_phys_get_fd(backend, opt_cached);
+  if (fd < 0) {
+    map_phys_close_unused();
+    goto unlock;
+  }
+
   mm = (unsigned char *)mmap(NULL, mem_window_size, PROT_WRITE|PROT_READ,
-              MAP_SHARED, fd, region_base & ~(pagesize-1));
-  mem = mm + (region_base & (pagesize-1));
+              MAP_SHARED, fd, map_offs);
 
   if (mm == MAP_FAILED) {
     fprintf(stderr,"mmap error\n");
-    return NULL;
+    map_phys_close_unused();
+    goto unlock;
   }
 
+  ent = &map_phys_cache[map_phys_cache_cnt++];
+  ent->mm = mm;
+  ent->base = window_base;
+  ent->size = mem_window_size;
+  ent->backend = backend;
+  ent->cached = opt_cached;
+  ent->refcnt = 1;
+
+  if (backend == MAP_PHYS_BACKEND_SIM)
+    __atomic_add_fetch(&mzapo_sim_active, 1, __ATOMIC_RELEASE);
+
+  mem = mm + (region_base & (pagesize-1));
+
+unlock:
+  pthread_mutex_unlock(&map_phys_lock);
+
   return (void *)mem;
 }
+
+int unmap_phys_address(void *mem)
+{
+  unsigned char *p = (unsigned char *)mem;
+  map_phys_entry_t *ent;
+  int ret = -1;
+  int i;
+
+  pthread_mutex_lock(&map_phys_lock);
+
+  for (i = 0; i < map_phys_cache_cnt; i++) {
+    ent = &map_phys_cache[i];
+    if ((p >= ent->mm) && (p < ent->mm + ent->size)) {
+      if (!--ent->refcnt) {
+        if (ent->backend == MAP_PHYS_BACKEND_SIM)
+          __atomic_sub_fetch(&mzapo_sim_active, 1, __ATOMIC_RELEASE);
+        munmap(ent->mm, ent->size);
+        *ent = map_phys_cache[--map_phys_cache_cnt];
+        map_phys_close_unused();
+      }
+      ret = 0;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&map_phys_lock);
+
+  return ret;
+}
+
+int map_phys_mem_backend(const void *mem)
+{
+  const unsigned char *p = (const unsigned char *)mem;
+  map_phys_entry_t *ent;
+  int ret = -1;
+  int i;
+
+  pthread_mutex_lock(&map_phys_lock);
+
+  for (i = 0; i < map_phys_cache_cnt; i++) {
+    ent = &map_phys_cache[i];
+    if ((p >= ent->mm) && (p < ent->mm + ent->size)) {
+      ret = ent->backend;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&map_phys_lock);
+
+  return ret;
+}
+
+int map_phys_all_regs(map_phys_regs_t *regs, int opt_cached)
+{
+  void *all;
+
+  /*
+    All blocks sit inside one 448 KiB area, map it at once and let
+    the individual regions take references into that window.
+  */
+  all = map_phys_address(PARLCD_REG_BASE_PHYS,
+                         AUDIOPWM_REG_BASE_PHYS + AUDIOPWM_REG_SIZE - PARLCD_REG_BASE_PHYS,
+                         opt_cached);
+  if (all == NULL)
+    return -1;
+
+  regs->parlcd = map_phys_address(PARLCD_REG_BASE_PHYS, PARLCD_REG_SIZE, opt_cached);
+  regs->spiled = map_phys_address(SPILED_REG_BASE_PHYS, SPILED_REG_SIZE, opt_cached);
+  regs->servops2 = map_phys_address(SERVOPS2_REG_BASE_PHYS, SERVOPS2_REG_SIZE, opt_cached);
+  regs->audiopwm = map_phys_address(AUDIOPWM_REG_BASE_PHYS, AUDIOPWM_REG_SIZE, opt_cached);
+  regs->dcspdrv[0] = map_phys_address(DCSPDRV_REG_BASE_PHYS_0, DCSPDRV_REG_SIZE, opt_cached);
+  regs->dcspdrv[1] = map_phys_address(DCSPDRV_REG_BASE_PHYS_1, DCSPDRV_REG_SIZE, opt_cached);
+
+  unmap_phys_address(all);
+
+  if (!regs->parlcd || !regs->spiled || !regs->servops2 || !regs->audiopwm ||
+      !regs->dcspdrv[0] || !regs->dcspdrv[1]) {
+    unmap_phys_all_regs(regs);
+    return -1;
+  }
+
+  return 0;
+}
+
+void unmap_phys_all_regs(map_phys_regs_t *regs)
+{
+  unmap_phys_address(regs->parlcd);
+  unmap_phys_address(regs->spiled);
+  unmap_phys_address(regs->servops2);
+  unmap_phys_address(regs->audiopwm);
+  unmap_phys_address(regs->dcspdrv[0]);
+  unmap_phys_address(regs->dcspdrv[1]);
+  memset(regs, 0, sizeof(*regs));
+}
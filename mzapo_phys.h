@@ -21,8 +21,45 @@
 extern "C" {
 #endif
 
+#define MAP_PHYS_BACKEND_DEVMEM  0
+#define MAP_PHYS_BACKEND_SIM     1
+
+/*
+  Selects where map_phys_address() takes registers from. Without
+  the call the MZAPO_SIM environment variable decides. The simulated
+  backend uses sim_file, or the MZAPO_SIM file name or the default
+  shared memory file when sim_file is NULL.
+*/
+int map_phys_set_backend(int backend, const char *sim_file);
+
+int map_phys_get_backend(void);
+
+/*
+  Mappings are cached, a region inside an already mapped window of
+  the same caching mode shares it and only increments its reference
+  count. One memory device descriptor is kept open per mode.
+*/
 void *map_phys_address(off_t region_base, size_t region_size, int opt_cached);
 
+/* Drops reference taken by map_phys_address(), unmaps at zero */
+int unmap_phys_address(void *mem);
+
+/* Backend serving the mapped address, -1 when it is not mapped */
+int map_phys_mem_backend(const void *mem);
+
+typedef struct map_phys_regs_t {
+  unsigned char *parlcd;
+  unsigned char *spiled;
+  unsigned char *servops2;
+  unsigned char *audiopwm;
+  unsigned char *dcspdrv[2];
+} map_phys_regs_t;
+
+/* Maps all MZ_APO peripheral blocks from mzapo_regs.h at once */
+int map_phys_all_regs(map_phys_regs_t *regs, int opt_cached);
+
+void unmap_phys_all_regs(map_phys_regs_t *regs);
+
 #ifdef __cplusplus
 } /* extern "C"*/
 #endif
@@ -56,6 +56,10 @@
 #define SERVOPS2_REG_SIZE      0x4000
 
 #define SERVOPS2_REG_CR_o               0x0000
+#define SERVOPS2_REG_CR_PWM1_EN_m              0x00000001
+#define SERVOPS2_REG_CR_PWM2_EN_m              0x00000002
+#define SERVOPS2_REG_CR_PWM3_EN_m              0x00000004
+#define SERVOPS2_REG_CR_PWM4_EN_m              0x00000008
 #define SERVOPS2_REG_PWMPER_o           0x000C
 #define SERVOPS2_REG_PWM1_o             0x0010
 #define SERVOPS2_REG_PWM2_o             0x0014
@@ -0,0 +1,403 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  mzapo_sim.c      - host side emulator of the MZ_APO peripherals,
+                     decodes LCD command/data stream into an image
+                     and runs DC motor plants behind DCSPDRV blocks
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mzapo_parlcd.h"
+#include "mzapo_phys.h"
+#include "mzapo_regs.h"
+#include "mzapo_sim.h"
+
+typedef struct lcd_state_t {
+  uint16_t pixels[PARLCD_HEIGHT][PARLCD_WIDTH];
+  unsigned cmd;
+  int      nparam;
+  uint8_t  param[8];
+  int      mem_write;
+  int      xs, xe, ys, ye;
+  int      x, y;
+  uint8_t  madctl;
+  int      scroll;
+  int      tfa, vsa, vsp;
+  unsigned long cmds;
+  unsigned long data;
+  unsigned long frames;
+} lcd_state_t;
+
+/*
+  First order DC motor: speed follows duty with time constant tau,
+  full duty gives vmax IRC counts per second.
+*/
+typedef struct motor_plant_t {
+  unsigned char *dcspdrv_mem_base;
+  double         vmax;
+  double         tau;
+  double         pos;
+  double         vel;
+} motor_plant_t;
+
+/* Longest integration step of the motor model, seconds */
+#define MOTOR_PLANT_STEP  50e-6
+
+static volatile sig_atomic_t sim_stop;
+static volatile sig_atomic_t sim_snapshot;
+
+static void sim_signal(int sig)
+{
+  if (sig == SIGUSR1)
+    sim_snapshot = 1;
+  else
+    sim_stop = 1;
+}
+
+static void lcd_reset(lcd_state_t *lcd)
+{
+  lcd->cmd = 0;
+  lcd->nparam = 0;
+  lcd->mem_write = 0;
+  lcd->xs = 0;
+  lcd->xe = PARLCD_WIDTH - 1;
+  lcd->ys = 0;
+  lcd->ye = PARLCD_HEIGHT - 1;
+  lcd->x = 0;
+  lcd->y = 0;
+  lcd->scroll = 0;
+}
+
+static void lcd_command(lcd_state_t *lcd, unsigned cmd)
+{
+  lcd->cmds++;
+  lcd->cmd = cmd;
+  lcd->nparam = 0;
+  lcd->mem_write = 0;
+
+  switch (cmd) {
+    case 0x01: // Software reset
+      lcd_reset(lcd);
+      break;
+    case 0x13: // Normal display mode on, leaves scrolling
+      lcd->scroll = 0;
+      break;
+    case 0x2C: // Memory write
+      lcd->frames++;
+      lcd->x = lcd->xs;
+      lcd->y = lcd->ys;
+      lcd->mem_write = 1;
+      break;
+    case 0x3C: // Memory write continue
+      lcd->mem_write = 1;
+      break;
+  }
+}
+
+static void lcd_pixel(lcd_state_t *lcd, uint16_t color)
+{
+  if ((lcd->x < PARLCD_WIDTH) && (lcd->y < PARLCD_HEIGHT))
+    lcd->pixels[lcd->y][lcd->x] = color;
+
+  if (++lcd->x > lcd->xe) {
+    lcd->x = lcd->xs;
+    if (++lcd->y > lcd->ye)
+      lcd->y = lcd->ys;
+  }
+}
+
+static void lcd_data(lcd_state_t *lcd, uint16_t data)
+{
+  lcd->data++;
+
+  if (lcd->mem_write) {
+    lcd_pixel(lcd, data);
+    return;
+  }
+
+  if (lcd->nparam < (int)sizeof(lcd->param))
+    lcd->param[lcd->nparam] = data;
+  lcd->nparam++;
+
+  switch (lcd->cmd) {
+    case 0x2A: // Column address set
+      if (lcd->nparam == 4) {
+        lcd->xs = (lcd->param[0] << 8) | lcd->param[1];
+        lcd->xe = (lcd->param[2] << 8) | lcd->param[3];
+      }
+      break;
+    case 0x2B: // Page address set
+      if (lcd->nparam == 4) {
+        lcd->ys = (lcd->param[0] << 8) | lcd->param[1];
+        lcd->ye = (lcd->param[2] << 8) | lcd->param[3];
+      }
+      break;
+    case 0x33: // Vertical scrolling definition
+      if (lcd->nparam == 6) {
+        lcd->tfa = (lcd->param[0] << 8) | lcd->param[1];
+        lcd->vsa = (lcd->param[2] << 8) | lcd->param[3];
+        lcd->vsp = lcd->tfa;
+        lcd->scroll = 1;
+      }
+      break;
+    case 0x36: // MADCTL
+      lcd->madctl = data;
+      break;
+    case 0x37: // Vertical scrolling start address
+      if (lcd->nparam == 2)
+        lcd->vsp = (lcd->param[0] << 8) | lcd->param[1];
+      break;
+  }
+}
+
+/*
+  Memory row shown at the panel row, scrolling rotates rows tfa..
+  tfa+vsa-1 so the row vsp is displayed first
+*/
+static int lcd_scroll_row(lcd_state_t *lcd, int row)
+{
+  if (!lcd->scroll || lcd->vsa <= 0 || row < lcd->tfa || row >= lcd->tfa + lcd->vsa)
+    return row;
+
+  return lcd->tfa + (row - lcd->tfa + lcd->vsp - lcd->tfa + lcd->vsa) % lcd->vsa;
+}
+
+/*
+  Displayed pixel, panel rows follow logical x when MADCTL exchanges
+  rows and columns and run backwards with the row order bit
+*/
+static uint16_t lcd_display_pixel(lcd_state_t *lcd, int x, int y)
+{
+  int mv = lcd->madctl & PARLCD_MADCTL_MV_m;
+  int line = mv? x: y;
+  int row;
+
+  if (lcd->madctl & PARLCD_MADCTL_MY_m)
+    row = PARLCD_SCROLL_LINES - 1 - line;
+  else
+    row = line;
+  row = lcd_scroll_row(lcd, row);
+  if (lcd->madctl & PARLCD_MADCTL_MY_m)
+    line = PARLCD_SCROLL_LINES - 1 - row;
+  else
+    line = row;
+
+  if (mv)
+    x = line;
+  else
+    y = line;
+  if (x < 0 || x >= PARLCD_WIDTH || y < 0 || y >= PARLCD_HEIGHT)
+    return 0;
+
+  return lcd->pixels[y][x];
+}
+
+static int lcd_save_ppm(lcd_state_t *lcd, const char *fname)
+{
+  FILE *f = fopen(fname, "wb");
+  int x, y;
+
+  if (f == NULL) {
+    fprintf(stderr, "cannot write %s\n", fname);
+    return -1;
+  }
+
+  fprintf(f, "P6\n%d %d\n255\n", PARLCD_WIDTH, PARLCD_HEIGHT);
+  for (y = 0; y < PARLCD_HEIGHT; y++) {
+    for (x = 0; x < PARLCD_WIDTH; x++) {
+      uint16_t c = lcd_display_pixel(lcd, x, y);
+      unsigned char rgb[3] = {(c >> 8) & 0xf8, (c >> 3) & 0xfc, (c << 3) & 0xf8};
+      fwrite(rgb, 1, 3, f);
+    }
+  }
+
+  return fclose(f);
+}
+
+static void motor_plant_run(motor_plant_t *m, double dt)
+{
+  volatile uint32_t *regs = (volatile uint32_t *)m->dcspdrv_mem_base;
+  uint32_t cr = regs[DCSPDRV_REG_CR_o / 4];
+  uint32_t period = regs[DCSPDRV_REG_PERIOD_o / 4] & DCSPDRV_REG_PERIOD_MASK_m;
+  uint32_t duty = regs[DCSPDRV_REG_DUTY_o / 4];
+  double u = 0, h;
+  int64_t cnt;
+  unsigned q;
+
+  if (cr & DCSPDRV_REG_CR_IRC_RESET_m)
+    m->pos = 0;
+
+  if ((cr & DCSPDRV_REG_CR_PWM_ENABLE_m) && period) {
+    u = (double)(duty & DCSPDRV_REG_DUTY_MASK_m) / period;
+    if (u > 1)
+      u = 1;
+    if (duty & DCSPDRV_REG_DUTY_DIR_B_m)
+      u = -u;
+    else if (!(duty & DCSPDRV_REG_DUTY_DIR_A_m))
+      u = 0;
+  }
+
+  for (; dt > 0; dt -= h) {
+    h = dt < MOTOR_PLANT_STEP? dt: MOTOR_PLANT_STEP;
+    m->vel += (u * m->vmax - m->vel) * h / m->tau;
+    m->pos += m->vel * h;
+  }
+
+  cnt = (int64_t)floor(m->pos);
+  regs[DCSPDRV_REG_IRC_o / 4] = (uint32_t)cnt;
+
+  /* quadrature phase of the count, A leads B forward */
+  q = cnt & 3;
+  regs[DCSPDRV_REG_SR_o / 4] =
+      ((q == 1 || q == 2)? DCSPDRV_REG_SR_IRC_A_MON_m: 0) |
+      ((q >= 2)? DCSPDRV_REG_SR_IRC_B_MON_m: 0);
+}
+
+static double sim_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [-f sim_file] [-o image.ppm] [-p snapshot_ms]\n"
+          "          [-v motor_counts_per_s] [-t motor_tau_ms]\n"
+          "  decodes LCD stream written through the simulated registers,\n"
+          "  image is saved on SIGUSR1, periodically and at exit,\n"
+          "  DC motors follow DCSPDRV duty and report IRC position\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *sim_file = NULL;
+  const char *out_file = "mzapo_sim.ppm";
+  double period = 0, next_snapshot = 0;
+  double motor_vmax = 20000, motor_tau = 0.03;
+  double now, last;
+  unsigned char *parlcd_mem_base;
+  static motor_plant_t motor[2];
+  parlcd_sim_ring_t *ring;
+  static lcd_state_t lcd;
+  struct sigaction sa;
+  int opt, i;
+
+  while ((opt = getopt(argc, argv, "f:o:p:v:t:h")) != -1) {
+    switch (opt) {
+      case 'f':
+        sim_file = optarg;
+        break;
+      case 'o':
+        out_file = optarg;
+        break;
+      case 'p':
+        period = atoi(optarg) / 1000.0;
+        break;
+      case 'v':
+        motor_vmax = atof(optarg);
+        break;
+      case 't':
+        motor_tau = atoi(optarg) / 1000.0;
+        if (motor_tau <= 0)
+          motor_tau = 0.001;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h'? 0: 1;
+    }
+  }
+
+  map_phys_set_backend(MAP_PHYS_BACKEND_SIM, sim_file);
+
+  parlcd_mem_base = map_phys_address(PARLCD_REG_BASE_PHYS, PARLCD_REG_SIZE, 0);
+  if (parlcd_mem_base == NULL)
+    return 1;
+  ring = (parlcd_sim_ring_t *)(parlcd_mem_base + PARLCD_SIM_RING_o);
+
+  motor[0].dcspdrv_mem_base = map_phys_address(DCSPDRV_REG_BASE_PHYS_0, DCSPDRV_REG_SIZE, 0);
+  motor[1].dcspdrv_mem_base = map_phys_address(DCSPDRV_REG_BASE_PHYS_1, DCSPDRV_REG_SIZE, 0);
+  if ((motor[0].dcspdrv_mem_base == NULL) || (motor[1].dcspdrv_mem_base == NULL))
+    return 1;
+  for (i = 0; i < 2; i++) {
+    motor[i].vmax = motor_vmax;
+    motor[i].tau = motor_tau;
+    motor[i].pos = (int32_t)*(volatile uint32_t *)(motor[i].dcspdrv_mem_base +
+                                                   DCSPDRV_REG_IRC_o);
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sim_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGUSR1, &sa, NULL);
+
+  lcd_reset(&lcd);
+
+  /* attach, anything queued before belongs to nobody */
+  ring->magic = PARLCD_SIM_MAGIC;
+  __atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->consumer, 1, __ATOMIC_RELEASE);
+
+  last = sim_now();
+  if (period > 0)
+    next_snapshot = last + period;
+
+  while (!sim_stop) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (tail == head) {
+      struct timespec idle = {.tv_sec = 0, .tv_nsec = 200 * 1000};
+      nanosleep(&idle, NULL);
+    }
+
+    for (; tail != head; tail++) {
+      uint32_t word = ring->entry[tail % PARLCD_SIM_RING_LEN];
+      if (word & PARLCD_SIM_CMD_m)
+        lcd_command(&lcd, word & 0xffff);
+      else
+        lcd_data(&lcd, word);
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+    now = sim_now();
+    for (i = 0; i < 2; i++)
+      motor_plant_run(&motor[i], now - last);
+    last = now;
+
+    if ((period > 0) && (sim_now() >= next_snapshot)) {
+      sim_snapshot = 1;
+      next_snapshot += period;
+    }
+    if (sim_snapshot) {
+      sim_snapshot = 0;
+      lcd_save_ppm(&lcd, out_file);
+    }
+  }
+
+  __atomic_store_n(&ring->consumer, 0, __ATOMIC_RELEASE);
+  lcd_save_ppm(&lcd, out_file);
+
+  printf("commands=%lu data_words=%lu mem_writes=%lu\n",
+         lcd.cmds, lcd.data, lcd.frames);
+
+  return 0;
+}
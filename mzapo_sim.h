@@ -0,0 +1,62 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  mzapo_sim.h      - layout of the simulated register window shared
+                     between applications and the mzapo_sim emulator
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef MZAPO_SIM_H
+#define MZAPO_SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  The backing file mirrors physical addresses starting at
+  MZAPO_SIM_PHYS_BASE, so PARLCD, DCSPDRV, SPILED, SERVOPS2 and
+  AUDIOPWM blocks keep their offsets from mzapo_regs.h.
+*/
+#define MZAPO_SIM_PHYS_BASE    0x43c00000
+#define MZAPO_SIM_PHYS_SIZE    0x00070000
+
+/* Environment variable selecting the simulated backend, value is
+   the backing file name or "1" for MZAPO_SIM_DEFAULT_FILE */
+#define MZAPO_SIM_ENV          "MZAPO_SIM"
+#define MZAPO_SIM_DEFAULT_FILE "/dev/shm/mzapo_sim"
+
+/*
+  Register writes only leave the last value in memory, so LCD command
+  and data words are additionally queued into a ring placed in the
+  unused part of the PARLCD block where the emulator decodes them.
+*/
+#define PARLCD_SIM_RING_o      0x1000
+#define PARLCD_SIM_RING_LEN    2048
+#define PARLCD_SIM_MAGIC       0x4c434453
+#define PARLCD_SIM_CMD_m       0x00010000
+
+typedef struct parlcd_sim_ring_t {
+  uint32_t magic;
+  uint32_t consumer;     /* nonzero while the emulator drains the ring */
+  uint32_t head;         /* advanced by the application */
+  uint32_t tail;         /* advanced by the emulator */
+  uint32_t entry[PARLCD_SIM_RING_LEN];
+} parlcd_sim_ring_t;
+
+/*
+  Number of windows served by the simulation, zero again once the
+  last one is unmapped. Only a quick test, the mapping backend decides.
+*/
+extern int mzapo_sim_active;
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*MZAPO_SIM_H*/
@@ -1,22 +1,132 @@
+#define _GNU_SOURCE
+
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
+#include "mzapo_parlcd.h"
+#include "mzapo_phys.h"
+#include "mzapo_regs.h"
 #include "serialize_lock.h"
 
 const char *serialize_lock_fname = "/run/lock/serialize_lock";
 int serialize_lock_fd = -1;
 
-int serialize_lock(int no_wait)
+const char *serialize_lock_fair_fname = "/run/lock/serialize_lock.fair";
+
+/*
+  Ticket lock shared by all processes through a mapped file. All zero
+  content is the free state with ticket 0 granted, so whoever creates
+  the file does not need to initialize it.
+
+  Each ticket has a slot word holding the ticket number and its state.
+  The releaser grants the next ticket and the waiter gives up its
+  ticket on timeout by compare and swap on the same slot, so exactly
+  one of them decides. Waiters sleep on their own slot with futex.
+
+  The owner word says whether the granted ticket t was claimed by its
+  waiter (2t+1) or released (2t+2). Unlock by the holder and reclaim
+  by a waiter are both compare and swap from the claimed value, so a
+  stalled holder which wakes up late cannot release a second time.
+*/
+#define SLOT_GRANTED    0
+#define SLOT_WAITING    1
+#define SLOT_ABANDONED  2
+#define SLOT_TAG(t, st) (((t) << 2) | (st))
+
+#define OWNER_CLAIMED(t)  ((t) * 2 + 1)
+#define OWNER_RELEASED(t) ((t) * 2 + 2)
+
+/* Waiters wake up at least this often to look for a dead holder */
+#define SERIALIZE_LOCK_CHECK_MS 100
+
+/* Longest wait of a reclaiming waiter for the lockf lock */
+#define SERIALIZE_LOCK_RECLAIM_MS 1000
+
+typedef struct serialize_lock_shm_t {
+  uint32_t next_ticket;
+  uint32_t serving;          /* ticket of the current or last holder */
+  int32_t  holder_pid;
+  uint32_t slot[SERIALIZE_LOCK_SLOTS];
+  uint32_t waiter_ticket[SERIALIZE_LOCK_SLOTS];
+  int32_t  waiter_pid[SERIALIZE_LOCK_SLOTS];
+  /* updated by the holder only */
+  uint64_t acquisitions;
+  uint64_t wait_total_ns;
+  uint64_t wait_max_ns;
+  uint64_t wait_hist[SERIALIZE_LOCK_HIST_BINS];
+  /* updated by anybody */
+  uint64_t timeouts;
+  uint64_t reclaims;
+  /* lease of the claimed ticket */
+  uint32_t owner;
+  uint32_t lease_ms;
+  uint64_t heartbeat_ns;
+  uint64_t lease_reclaims;
+  /* holder which got the lockf lock too, 0 before and after */
+  int32_t  lockf_pid;
+} serialize_lock_shm_t;
+
+static const long serialize_lock_hist_bounds[SERIALIZE_LOCK_HIST_BINS] =
+  SERIALIZE_LOCK_HIST_BOUNDS;
+
+static int serialize_lock_mode = -1;
+static serialize_lock_shm_t *serialize_lock_shm;
+static int serialize_lock_held;
+static uint32_t serialize_lock_ticket;
+
+static void (*serialize_lock_reclaim_hook)(void *arg);
+static void *serialize_lock_reclaim_arg;
+
+int serialize_lock_set_mode(int mode)
 {
-  int fd;
+  if ((mode != SERIALIZE_LOCK_LOCKF) && (mode != SERIALIZE_LOCK_FAIR))
+    return -1;
+
+  serialize_lock_mode = mode;
+
+  return 0;
+}
+
+int serialize_lock_get_mode(void)
+{
+  const char *env;
+
+  if (serialize_lock_mode >= 0)
+    return serialize_lock_mode;
+
+  env = getenv(SERIALIZE_LOCK_MODE_ENV);
+  if ((env != NULL) && !strcmp(env, "fair"))
+    serialize_lock_mode = SERIALIZE_LOCK_FAIR;
+  else
+    serialize_lock_mode = SERIALIZE_LOCK_LOCKF;
+
+  return serialize_lock_mode;
+}
 
-  fd = open(serialize_lock_fname,
+static int serialize_lockf_open(void)
+{
+  return open(serialize_lock_fname,
     O_RDWR      |   /* open the file for both read and write access */
     O_CREAT     |   /* create file if it does not already exist */
     O_CLOEXEC   ,   /* close on execute */
     S_IRUSR     |   /* user permission: read */
     S_IWUSR     );  /* user permission: write */
+}
+
+static int serialize_lock_lockf(int no_wait)
+{
+  int fd;
+
+  fd = serialize_lockf_open();
 
   if (fd == -1)
     return -1;
@@ -25,12 +135,14 @@ int serialize_lock(int no_wait)
     /* try to lock the "semaphore", if busy report that */
     if (lockf( fd, F_TLOCK, 0 ) == -1) {
       close(fd);
-      return errno == EAGAIN? 0: -1;
+      return (errno == EAGAIN) || (errno == EACCES)? 0: -1;
     }
   } else  {
     /* lock the "semaphore", wait until available */
-    if (lockf( fd, F_LOCK, 0 ) == -1)
+    if (lockf( fd, F_LOCK, 0 ) == -1) {
+      close(fd);
       return -1;
+    }
   }
 
   serialize_lock_fd = fd;
@@ -38,16 +150,497 @@ int serialize_lock(int no_wait)
   return 1;
 }
 
-void serialize_unlock(void)
+static uint64_t serialize_lock_now_ns(void)
 {
-  int fd = serialize_lock_fd;
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Process holding the lockf lock, 0 when it is free, -1 on error */
+static pid_t serialize_lockf_owner(void)
+{
+  struct flock fl = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+  int fd;
+
+  fd = serialize_lockf_open();
+  if (fd == -1)
+    return -1;
+  if (fcntl(fd, F_GETLK, &fl) == -1) {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+
+  return fl.l_type == F_UNLCK? 0: fl.l_pid;
+}
 
+/*
+  Polls the lockf lock until the deadline (timeout_ms negative never),
+  returns the locked descriptor, -1 with errno EAGAIN when it stayed
+  busy or -1 on error
+*/
+static int serialize_lockf_poll(int timeout_ms, uint64_t deadline_ns)
+{
+  struct timespec poll = {.tv_sec = 0, .tv_nsec = 10 * 1000000};
+  int fd;
+
+  for (;;) {
+    fd = serialize_lockf_open();
+    if (fd == -1)
+      return -1;
+    if (lockf(fd, F_TLOCK, 0) == 0)
+      return fd;
+    close(fd);
+    if ((errno != EAGAIN) && (errno != EACCES))
+      return -1;
+    if ((timeout_ms >= 0) && (serialize_lock_now_ns() >= deadline_ns)) {
+      errno = EAGAIN;
+      return -1;
+    }
+    nanosleep(&poll, NULL);
+  }
+}
+
+static serialize_lock_shm_t *serialize_lock_map(void)
+{
+  void *mm;
+  int fd;
+
+  if (serialize_lock_shm != NULL)
+    return serialize_lock_shm;
+
+  fd = open(serialize_lock_fair_fname, O_RDWR | O_CREAT | O_CLOEXEC,
+            S_IRUSR | S_IWUSR);
   if (fd == -1)
+    return NULL;
+
+  /* growing only, a concurrent creator cannot truncate live state */
+  if (ftruncate(fd, sizeof(serialize_lock_shm_t)) == -1) {
+    close(fd);
+    return NULL;
+  }
+
+  mm = mmap(NULL, sizeof(serialize_lock_shm_t), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+  close(fd);
+  if (mm == MAP_FAILED)
+    return NULL;
+
+  serialize_lock_shm = (serialize_lock_shm_t *)mm;
+
+  return serialize_lock_shm;
+}
+
+static void serialize_futex_wait(uint32_t *addr, uint32_t val, long ms)
+{
+  struct timespec rel = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
+
+  syscall(SYS_futex, addr, FUTEX_WAIT, val, &rel, NULL, 0);
+}
+
+static void serialize_futex_wake(uint32_t *addr)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE, 0x7fffffff, NULL, NULL, 0);
+}
+
+/* Passes the lock to the oldest ticket which was not abandoned */
+static void serialize_fair_release(serialize_lock_shm_t *shm)
+{
+  uint32_t t = __atomic_load_n(&shm->serving, __ATOMIC_ACQUIRE) + 1;
+  uint32_t *slot;
+  uint32_t v;
+  int32_t pid = 0;
+
+  for (;;) {
+    slot = &shm->slot[t % SERIALIZE_LOCK_SLOTS];
+    v = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (v == SLOT_TAG(t, SLOT_ABANDONED)) {
+      t++;
+      continue;
+    }
+    if (__atomic_compare_exchange_n(slot, &v, SLOT_TAG(t, SLOT_GRANTED), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      break;
+  }
+
+  if (__atomic_load_n(&shm->waiter_ticket[t % SERIALIZE_LOCK_SLOTS],
+                      __ATOMIC_ACQUIRE) == t)
+    pid = __atomic_load_n(&shm->waiter_pid[t % SERIALIZE_LOCK_SLOTS],
+                          __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->holder_pid, pid, __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->lockf_pid, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->lease_ms, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->heartbeat_ns, serialize_lock_now_ns(), __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->serving, t, __ATOMIC_RELEASE);
+  serialize_futex_wake(slot);
+  /* skipped abandoned tickets free slots for callers waiting on them */
+  serialize_futex_wake(&shm->serving);
+}
+
+void serialize_lock_set_reclaim_hook(void (*hook)(void *arg), void *arg)
+{
+  serialize_lock_reclaim_hook = hook;
+  serialize_lock_reclaim_arg = arg;
+}
+
+void serialize_lock_safe_state(void)
+{
+  map_phys_regs_t regs;
+  volatile uint32_t *reg;
+  int i;
+
+  if (map_phys_all_regs(&regs, 0))
     return;
 
-  /* close() automatically releases the file lock */
-  /* so technically the call with F_ULOCK is not necessary */
-  lockf( fd, F_ULOCK, 0 );
-  close( fd );
-  serialize_lock_fd = -1;
+  for (i = 0; i < 2; i++) {
+    reg = (volatile uint32_t *)(regs.dcspdrv[i] + DCSPDRV_REG_CR_o);
+    *reg &= ~DCSPDRV_REG_CR_PWM_ENABLE_m;
+    *(volatile uint32_t *)(regs.dcspdrv[i] + DCSPDRV_REG_DUTY_o) = 0;
+  }
+
+  *(volatile uint32_t *)(regs.spiled + SPILED_REG_LED_LINE_o) = 0;
+  *(volatile uint32_t *)(regs.spiled + SPILED_REG_LED_RGB1_o) = 0;
+  *(volatile uint32_t *)(regs.spiled + SPILED_REG_LED_RGB2_o) = 0;
+
+  parlcd_set_window(regs.parlcd, 0, 0, PARLCD_WIDTH - 1, PARLCD_HEIGHT - 1);
+  parlcd_write_cmd(regs.parlcd, 0x2c);
+  for (i = 0; i < PARLCD_WIDTH * PARLCD_HEIGHT / 2; i++)
+    parlcd_write_data2x(regs.parlcd, 0);
+
+  unmap_phys_all_regs(&regs);
+}
+
+/*
+  Takes the lock away from a holder which exited without unlocking
+  or let its lease expire, the board is put to safe state before the
+  next job gets it.
+*/
+static void serialize_fair_check_holder(serialize_lock_shm_t *shm)
+{
+  uint32_t s = __atomic_load_n(&shm->serving, __ATOMIC_ACQUIRE);
+  uint32_t owner = __atomic_load_n(&shm->owner, __ATOMIC_ACQUIRE);
+  int32_t pid = __atomic_load_n(&shm->holder_pid, __ATOMIC_ACQUIRE);
+  int32_t lockf_pid = __atomic_load_n(&shm->lockf_pid, __ATOMIC_ACQUIRE);
+  uint32_t lease_ms = __atomic_load_n(&shm->lease_ms, __ATOMIC_RELAXED);
+  uint64_t beat_ns = __atomic_load_n(&shm->heartbeat_ns, __ATOMIC_RELAXED);
+  uint64_t *counter;
+  pid_t lock_owner = 0;
+  int fd;
+
+  if (owner == OWNER_RELEASED(s))
+    return;
+
+  if (lockf_pid > 0) {
+    /*
+      The kernel knows the lockf owner, the stored pid may have been
+      reused. The holder clears lockf_pid before it unlocks, so a lock
+      not owned by it while the pid is still stored means it died.
+    */
+    lock_owner = serialize_lockf_owner();
+    if (lock_owner == -1)
+      return;
+    if ((lock_owner != lockf_pid) &&
+        (__atomic_load_n(&shm->lockf_pid, __ATOMIC_ACQUIRE) == lockf_pid))
+      counter = &shm->reclaims;
+    else if ((lock_owner == lockf_pid) && (owner == OWNER_CLAIMED(s)) && lease_ms &&
+             (serialize_lock_now_ns() - beat_ns > (uint64_t)lease_ms * 1000000))
+      counter = &shm->lease_reclaims;
+    else
+      return;
+  } else if ((pid > 0) && (kill(pid, 0) == -1) && (errno == ESRCH)) {
+    /* granted but not holding lockf yet, only the waiter pid is known */
+    counter = &shm->reclaims;
+  } else {
+    return;
+  }
+
+  /* only one waiter wins the reclaim */
+  if (!__atomic_compare_exchange_n(&shm->owner, &owner, OWNER_RELEASED(s), 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    return;
+  __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+
+  /* a stalled holder keeps its lockf lock until it is gone */
+  if ((counter == &shm->lease_reclaims) && (lock_owner > 0) && (lock_owner != getpid()))
+    kill(lock_owner, SIGKILL);
+
+  /*
+    The board is reset only under the lockf lock, a lockf mode job
+    which got the lock after the holder died is left alone
+  */
+  fd = serialize_lockf_poll(SERIALIZE_LOCK_RECLAIM_MS, serialize_lock_now_ns() +
+                            (uint64_t)SERIALIZE_LOCK_RECLAIM_MS * 1000000);
+  if (fd != -1) {
+    if (serialize_lock_reclaim_hook != NULL)
+      serialize_lock_reclaim_hook(serialize_lock_reclaim_arg);
+    else
+      serialize_lock_safe_state();
+    close(fd);
+  }
+
+  serialize_fair_release(shm);
+}
+
+static void serialize_fair_account(serialize_lock_shm_t *shm, uint64_t wait_ns)
+{
+  long wait_ms = wait_ns / 1000000;
+  int bin;
+
+  for (bin = 0; bin < SERIALIZE_LOCK_HIST_BINS - 1; bin++)
+    if (wait_ms < serialize_lock_hist_bounds[bin])
+      break;
+  shm->wait_hist[bin]++;
+  shm->acquisitions++;
+  shm->wait_total_ns += wait_ns;
+  if (wait_ns > shm->wait_max_ns)
+    shm->wait_max_ns = wait_ns;
+}
+
+static int serialize_lock_fair(int timeout_ms, int lease_ms)
+{
+  serialize_lock_shm_t *shm = serialize_lock_map();
+  uint64_t start_ns = serialize_lock_now_ns();
+  uint64_t deadline_ns = start_ns + (uint64_t)timeout_ms * 1000000;
+  uint64_t now_ns;
+  uint32_t t, s, *slot, v, owner;
+  long ms;
+  int fd;
+
+  if (shm == NULL)
+    return -1;
+  if (serialize_lock_held)
+    return -1;
+
+retry:
+  t = __atomic_load_n(&shm->next_ticket, __ATOMIC_ACQUIRE);
+  for (;;) {
+    s = __atomic_load_n(&shm->serving, __ATOMIC_ACQUIRE);
+
+    /*
+      The granted ticket is untaken only when the lock is free, a busy
+      lock is reported without leaving an abandoned ticket behind
+    */
+    if ((timeout_ms == 0) && (t != s)) {
+      serialize_fair_check_holder(shm);
+      return 0;
+    }
+
+    /* abandoned tickets hold their slots until the holder releases */
+    if (t - s >= SERIALIZE_LOCK_SLOTS - 1) {
+      now_ns = serialize_lock_now_ns();
+      if ((timeout_ms >= 0) && (now_ns >= deadline_ns)) {
+        __atomic_fetch_add(&shm->timeouts, 1, __ATOMIC_RELAXED);
+        return 0;
+      }
+      ms = SERIALIZE_LOCK_CHECK_MS;
+      if ((timeout_ms >= 0) && ((deadline_ns - now_ns) / 1000000 + 1 < (uint64_t)ms))
+        ms = (deadline_ns - now_ns) / 1000000 + 1;
+      serialize_futex_wait(&shm->serving, s, ms);
+      serialize_fair_check_holder(shm);
+      t = __atomic_load_n(&shm->next_ticket, __ATOMIC_ACQUIRE);
+      continue;
+    }
+
+    if (__atomic_compare_exchange_n(&shm->next_ticket, &t, t + 1, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      break;
+  }
+
+  slot = &shm->slot[t % SERIALIZE_LOCK_SLOTS];
+  __atomic_store_n(&shm->waiter_pid[t % SERIALIZE_LOCK_SLOTS], getpid(),
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->waiter_ticket[t % SERIALIZE_LOCK_SLOTS], t,
+                   __ATOMIC_RELEASE);
+
+  for (;;) {
+    v = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (v == SLOT_TAG(t, SLOT_GRANTED))
+      break;
+
+    now_ns = serialize_lock_now_ns();
+    if ((timeout_ms >= 0) && (now_ns >= deadline_ns)) {
+      /* give the ticket up unless it was granted meanwhile */
+      if (__atomic_compare_exchange_n(slot, &v, SLOT_TAG(t, SLOT_ABANDONED), 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        if (timeout_ms > 0)
+          __atomic_fetch_add(&shm->timeouts, 1, __ATOMIC_RELAXED);
+        return 0;
+      }
+      continue;
+    }
+
+    if ((v != SLOT_TAG(t, SLOT_WAITING)) &&
+        !__atomic_compare_exchange_n(slot, &v, SLOT_TAG(t, SLOT_WAITING), 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      continue;
+
+    ms = SERIALIZE_LOCK_CHECK_MS;
+    if ((timeout_ms >= 0) && ((deadline_ns - now_ns) / 1000000 + 1 < (uint64_t)ms))
+      ms = (deadline_ns - now_ns) / 1000000 + 1;
+    serialize_futex_wait(slot, SLOT_TAG(t, SLOT_WAITING), ms);
+
+    serialize_fair_check_holder(shm);
+  }
+
+  /* claim, unless a waiter declared the grant dead meanwhile */
+  owner = __atomic_load_n(&shm->owner, __ATOMIC_ACQUIRE);
+  do {
+    if (owner == OWNER_RELEASED(t))
+      goto retry;
+  } while (!__atomic_compare_exchange_n(&shm->owner, &owner, OWNER_CLAIMED(t), 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  /*
+    Holding the lockf lock too keeps lockf mode users off the board,
+    the ticket is passed on when it does not come in time
+  */
+  fd = serialize_lockf_poll(timeout_ms, deadline_ns);
+  if (fd == -1) {
+    int err = errno;
+
+    owner = OWNER_CLAIMED(t);
+    if (__atomic_compare_exchange_n(&shm->owner, &owner, OWNER_RELEASED(t), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      serialize_fair_release(shm);
+    if (err != EAGAIN)
+      return -1;
+    if (timeout_ms > 0)
+      __atomic_fetch_add(&shm->timeouts, 1, __ATOMIC_RELAXED);
+    return 0;
+  }
+  serialize_lock_fd = fd;
+  __atomic_store_n(&shm->lockf_pid, getpid(), __ATOMIC_RELEASE);
+
+  /* heartbeat first, the lease is not checked before lease_ms is set */
+  __atomic_store_n(&shm->heartbeat_ns, serialize_lock_now_ns(), __ATOMIC_RELAXED);
+  __atomic_store_n(&shm->lease_ms, lease_ms, __ATOMIC_RELEASE);
+  __atomic_store_n(&shm->holder_pid, getpid(), __ATOMIC_RELEASE);
+  serialize_fair_account(shm, serialize_lock_now_ns() - start_ns);
+  serialize_lock_ticket = t;
+  serialize_lock_held = 1;
+
+  return 1;
+}
+
+int serialize_lock(int no_wait)
+{
+  if (serialize_lock_get_mode() == SERIALIZE_LOCK_FAIR)
+    return serialize_lock_fair(no_wait? 0: -1, 0);
+
+  return serialize_lock_lockf(no_wait);
+}
+
+int serialize_lock_timed(int timeout_ms)
+{
+  struct timespec poll = {.tv_sec = 0, .tv_nsec = 10 * 1000000};
+  int ret;
+
+  if (serialize_lock_get_mode() == SERIALIZE_LOCK_FAIR)
+    return serialize_lock_fair(timeout_ms, 0);
+
+  if (timeout_ms < 0)
+    return serialize_lock_lockf(0);
+
+  /* lockf() cannot time out, poll for the rest */
+  for (;;) {
+    ret = serialize_lock_lockf(1);
+    if ((ret != 0) || (timeout_ms <= 0))
+      return ret;
+    nanosleep(&poll, NULL);
+    timeout_ms -= 10;
+  }
+}
+
+int serialize_lock_lease(int timeout_ms, int lease_ms)
+{
+  /* lease needs the shared state, the lockf lock is taken as well */
+  return serialize_lock_fair(timeout_ms, lease_ms > 0? lease_ms: 0);
+}
+
+int serialize_lock_heartbeat(void)
+{
+  serialize_lock_shm_t *shm = serialize_lock_shm;
+
+  if (!serialize_lock_held)
+    return serialize_lock_fd == -1? -1: 0;
+
+  if (__atomic_load_n(&shm->owner, __ATOMIC_ACQUIRE) !=
+      OWNER_CLAIMED(serialize_lock_ticket)) {
+    /* taken over, let the reclaiming waiter have the lockf lock */
+    serialize_lock_held = 0;
+    if (serialize_lock_fd != -1) {
+      close(serialize_lock_fd);
+      serialize_lock_fd = -1;
+    }
+    return -1;
+  }
+  __atomic_store_n(&shm->heartbeat_ns, serialize_lock_now_ns(), __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+void serialize_unlock(void)
+{
+  int fd = serialize_lock_fd;
+  uint32_t owner = OWNER_CLAIMED(serialize_lock_ticket);
+  int32_t pid = getpid();
+
+  /* waiters must not take the unlocked lockf for a dead holder */
+  if (serialize_lock_held)
+    __atomic_compare_exchange_n(&serialize_lock_shm->lockf_pid, &pid, 0, 0,
+                                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+
+  if (fd != -1) {
+    /* close() automatically releases the file lock */
+    /* so technically the call with F_ULOCK is not necessary */
+    lockf( fd, F_ULOCK, 0 );
+    close( fd );
+    serialize_lock_fd = -1;
+  }
+
+  if (serialize_lock_held) {
+    serialize_lock_held = 0;
+    /* nothing to pass on when the lock was reclaimed from us */
+    if (__atomic_compare_exchange_n(&serialize_lock_shm->owner, &owner,
+                                    OWNER_RELEASED(serialize_lock_ticket), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      serialize_fair_release(serialize_lock_shm);
+  }
+}
+
+int serialize_lock_get_info(serialize_lock_info_t *info)
+{
+  serialize_lock_shm_t *shm;
+  uint32_t depth;
+  int bin;
+
+  memset(info, 0, sizeof(*info));
+  info->mode = serialize_lock_get_mode();
+  if (info->mode != SERIALIZE_LOCK_FAIR)
+    return -1;
+
+  shm = serialize_lock_map();
+  if (shm == NULL)
+    return -1;
+
+  /* next ticket beyond the granted one means somebody is waiting */
+  depth = __atomic_load_n(&shm->next_ticket, __ATOMIC_ACQUIRE) -
+          __atomic_load_n(&shm->serving, __ATOMIC_ACQUIRE);
+  info->queue_depth = depth > 1? depth - 1: 0;
+  info->holder_pid = __atomic_load_n(&shm->holder_pid, __ATOMIC_ACQUIRE);
+  info->acquisitions = shm->acquisitions;
+  info->timeouts = __atomic_load_n(&shm->timeouts, __ATOMIC_RELAXED);
+  info->reclaims = __atomic_load_n(&shm->reclaims, __ATOMIC_RELAXED);
+  info->lease_reclaims = __atomic_load_n(&shm->lease_reclaims, __ATOMIC_RELAXED);
+  info->lease_ms = __atomic_load_n(&shm->lease_ms, __ATOMIC_RELAXED);
+  info->heartbeat_age_ms = (serialize_lock_now_ns() -
+                            __atomic_load_n(&shm->heartbeat_ns, __ATOMIC_RELAXED)) / 1000000;
+  info->wait_total_ns = shm->wait_total_ns;
+  info->wait_max_ns = shm->wait_max_ns;
+  for (bin = 0; bin < SERIALIZE_LOCK_HIST_BINS; bin++)
+    info->wait_hist[bin] = shm->wait_hist[bin];
+
+  return 0;
 }
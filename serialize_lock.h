@@ -7,10 +7,91 @@
 extern "C" {
 #endif
 
+/* lockf() on serialize_lock_fname, released when the process exits */
+#define SERIALIZE_LOCK_LOCKF   0
+/*
+  FIFO ticket lock in serialize_lock_fair_fname, the holder takes the
+  lockf lock as well so processes in either mode exclude each other.
+  The order is kept only among fair mode callers.
+*/
+#define SERIALIZE_LOCK_FAIR    1
+
+/* Environment variable selecting the mode, "fair" or "lockf" */
+#define SERIALIZE_LOCK_MODE_ENV "SERIALIZE_LOCK_MODE"
+
+/* Tickets outstanding at once, holder included, more callers wait */
+#define SERIALIZE_LOCK_SLOTS   64
+
+/* Wait time histogram bins, upper bounds in milliseconds */
+#define SERIALIZE_LOCK_HIST_BINS   8
+#define SERIALIZE_LOCK_HIST_BOUNDS {1, 10, 100, 1000, 10000, 60000, 600000, 0x7fffffff}
+
+typedef struct serialize_lock_info_t {
+  int           mode;
+  int           holder_pid;     /* 0 when free or not known yet */
+  int           queue_depth;    /* waiting tickets, abandoned ones included */
+  unsigned long acquisitions;
+  unsigned long timeouts;
+  unsigned long reclaims;       /* released on behalf of a dead holder */
+  unsigned long lease_reclaims; /* released after the lease expired */
+  int           lease_ms;       /* lease of the holder, 0 none */
+  int           heartbeat_age_ms;
+  uint64_t      wait_total_ns;
+  uint64_t      wait_max_ns;
+  unsigned long wait_hist[SERIALIZE_LOCK_HIST_BINS];
+} serialize_lock_info_t;
+
+extern const char *serialize_lock_fname;
+extern const char *serialize_lock_fair_fname;
+
+/* Overrides SERIALIZE_LOCK_MODE_ENV, call before the first lock */
+int serialize_lock_set_mode(int mode);
+
+int serialize_lock_get_mode(void);
+
+/*
+  Returns 1 when acquired, 0 when busy and no_wait, -1 on error.
+  A busy no_wait call does not take a ticket in fair mode.
+*/
 int serialize_lock(int no_wait);
 
+/*
+  Waits at most timeout_ms (negative forever), returns 1 when
+  acquired, 0 on timeout, -1 on error. Fair mode serves waiters in
+  the order of their arrival.
+*/
+int serialize_lock_timed(int timeout_ms);
+
+/*
+  Fair lock with lease, in any mode. The holder has to call
+  serialize_lock_heartbeat() more often than lease_ms, otherwise a
+  waiter kills it with SIGKILL, which releases its lockf lock, resets
+  peripherals and passes the lock on. Only the lockf owner reported by
+  F_GETLK is killed, a stored pid could have been reused. The reset runs only when the
+  waiter gets the lockf lock, never beside a live lockf mode job.
+*/
+int serialize_lock_lease(int timeout_ms, int lease_ms);
+
+/* Renews the lease, returns -1 and drops the lock when taken over */
+int serialize_lock_heartbeat(void);
+
 void serialize_unlock(void);
 
+/*
+  Called by the waiter which reclaims the lock from a dead or stalled
+  holder, NULL restores serialize_lock_safe_state()
+*/
+void serialize_lock_set_reclaim_hook(void (*hook)(void *arg), void *arg);
+
+/*
+  Motor PWM disabled, LEDs off and LCD cleared, the default action
+  on reclaim
+*/
+void serialize_lock_safe_state(void);
+
+/* Holder, queue and wait statistics, fair mode only */
+int serialize_lock_get_info(serialize_lock_info_t *info);
+
 #ifdef __cplusplus
 } /* extern "C"*/
 #endif
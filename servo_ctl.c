@@ -0,0 +1,354 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  servo_ctl.c      - RC servo outputs with motion profiles
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "servo_ctl.h"
+#include "mzapo_regs.h"
+
+#define SERVO_TICKS_PER_US   (SERVO_PWM_CLK_HZ / 1000000)
+
+static const unsigned servo_reg_offs[SERVO_CHANNELS] = {
+  SERVOPS2_REG_PWM1_o,
+  SERVOPS2_REG_PWM2_o,
+  SERVOPS2_REG_PWM3_o,
+  SERVOPS2_REG_PWM4_o,
+};
+
+static const servo_cfg_t servo_cfg_default = {
+  .min_us = 1000, .max_us = 2000,
+  .min_mdeg = -90000, .max_mdeg = 90000,
+  .vmax = 2000, .amax = 10000,
+  .profile = SERVO_PROFILE_TRAPEZOID,
+};
+
+static int64_t servo_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t servo_isqrt(uint64_t x)
+{
+  uint64_t res = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while (bit > x)
+    bit >>= 2;
+  while (bit) {
+    if (x >= res + bit) {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return res;
+}
+
+/*
+  Shortest time to travel dist_us within the channel limits. For
+  trapezoid the accelerating fraction of the time is returned too.
+*/
+static int64_t servo_plan(const servo_cfg_t *cfg, int32_t dist_us,
+                          uint32_t *accel_q16)
+{
+  uint64_t d = dist_us < 0? -(int64_t)dist_us: dist_us;
+  uint64_t v = cfg->vmax? cfg->vmax: 1;
+  uint64_t a = cfg->amax? cfg->amax: 1;
+  int64_t t_ns, ta_ns, t2_ns;
+
+  *accel_q16 = 0x8000;
+  if (d == 0)
+    return 0;
+
+  if (cfg->profile == SERVO_PROFILE_SCURVE) {
+    /* quintic blend, peak speed 1.875 d/T, peak accel 5.7735 d/T^2 */
+    t_ns = d * 1875000000 / v;
+    t2_ns = servo_isqrt(d * 5773503 * 1000000 / a) * 1000;
+    return t_ns > t2_ns? t_ns: t2_ns;
+  }
+
+  if (d * a >= v * v) {
+    ta_ns = v * 1000000000 / a;
+    t_ns = d * 1000000000 / v + ta_ns;
+  } else {
+    /* triangular, vmax is never reached */
+    ta_ns = servo_isqrt(d * 1000000000000 / a) * 1000;
+    t_ns = 2 * ta_ns;
+  }
+  if (t_ns <= 0)
+    return 0;
+  *accel_q16 = ((uint64_t)ta_ns << 16) / t_ns;
+  if (*accel_q16 > 0x8000)
+    *accel_q16 = 0x8000;
+  if (*accel_q16 == 0)
+    *accel_q16 = 1;
+
+  return t_ns;
+}
+
+/* Travelled fraction of the move at time fraction tau, both Q16 */
+static int64_t servo_shape(const servo_move_t *mv, int64_t tau)
+{
+  int64_t r = mv->accel_q16;
+  int64_t den;
+
+  if (mv->profile == SERVO_PROFILE_SCURVE) {
+    /* 10 t^3 - 15 t^4 + 6 t^5 */
+    int64_t t3 = (((tau * tau) >> 16) * tau) >> 16;
+    return (t3 * ((((tau * (6 * tau - 15 * 65536)) >> 16)) + 10 * 65536)) >> 16;
+  }
+
+  den = (2 * r * (65536 - r)) >> 16;
+  if (tau < r)
+    return tau * tau / den;
+  if (tau <= 65536 - r)
+    return ((tau - r / 2) << 16) / (65536 - r);
+  return 65536 - (65536 - tau) * (65536 - tau) / den;
+}
+
+static int32_t servo_eval(servo_move_t *mv, int64_t now_ns)
+{
+  int64_t elapsed = now_ns - mv->start_ns;
+  int64_t tau;
+
+  if (elapsed >= mv->time_ns) {
+    mv->active = 0;
+    return mv->start_us + mv->dist_us;
+  }
+  if (elapsed <= 0)
+    return mv->start_us;
+
+  tau = (elapsed << 16) / mv->time_ns;
+  return mv->start_us + ((mv->dist_us * servo_shape(mv, tau)) >> 16);
+}
+
+static int32_t servo_clamp_us(const servo_cfg_t *cfg, int32_t us)
+{
+  int32_t lo = cfg->min_us < cfg->max_us? cfg->min_us: cfg->max_us;
+  int32_t hi = cfg->min_us < cfg->max_us? cfg->max_us: cfg->min_us;
+
+  return us < lo? lo: us > hi? hi: us;
+}
+
+static void *servo_ctl_thread(void *arg)
+{
+  servo_ctl_t *sc = (servo_ctl_t *)arg;
+  struct timespec next;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!__atomic_load_n(&sc->stop, __ATOMIC_ACQUIRE)) {
+    servo_ctl_update(sc);
+
+    next.tv_nsec += sc->period_ns;
+    while (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+  }
+
+  return NULL;
+}
+
+int servo_ctl_init(servo_ctl_t *sc, unsigned char *servops2_mem_base,
+                   int update_hz)
+{
+  volatile uint32_t *cr;
+  int ch;
+
+  memset(sc, 0, sizeof(*sc));
+  sc->servops2_mem_base = servops2_mem_base;
+  pthread_mutex_init(&sc->lock, NULL);
+
+  *(volatile uint32_t *)(servops2_mem_base + SERVOPS2_REG_PWMPER_o) =
+      SERVO_FRAME_US * SERVO_TICKS_PER_US;
+  for (ch = 0; ch < SERVO_CHANNELS; ch++) {
+    sc->cfg[ch] = servo_cfg_default;
+    sc->pos_us[ch] = (sc->cfg[ch].min_us + sc->cfg[ch].max_us) / 2;
+    sc->shadow[ch] = sc->pos_us[ch] * SERVO_TICKS_PER_US;
+    *(volatile uint32_t *)(servops2_mem_base + servo_reg_offs[ch]) = sc->shadow[ch];
+  }
+  /* keep PS2 bits as they are */
+  cr = (volatile uint32_t *)(servops2_mem_base + SERVOPS2_REG_CR_o);
+  *cr |= SERVOPS2_REG_CR_PWM1_EN_m | SERVOPS2_REG_CR_PWM2_EN_m |
+         SERVOPS2_REG_CR_PWM3_EN_m | SERVOPS2_REG_CR_PWM4_EN_m;
+
+  if (update_hz <= 0)
+    return 0;
+
+  sc->period_ns = 1000000000L / update_hz;
+  if (pthread_create(&sc->thread, NULL, servo_ctl_thread, sc)) {
+    pthread_mutex_destroy(&sc->lock);
+    return -1;
+  }
+  sc->running = 1;
+
+  return 0;
+}
+
+void servo_ctl_done(servo_ctl_t *sc)
+{
+  if (sc->running) {
+    __atomic_store_n(&sc->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(sc->thread, NULL);
+    sc->running = 0;
+  }
+  pthread_mutex_destroy(&sc->lock);
+}
+
+void servo_ctl_config(servo_ctl_t *sc, int ch, const servo_cfg_t *cfg)
+{
+  pthread_mutex_lock(&sc->lock);
+  sc->cfg[ch] = *cfg;
+  pthread_mutex_unlock(&sc->lock);
+}
+
+int servo_ctl_move_us(servo_ctl_t *sc, int ch, int32_t pulse_us)
+{
+  int32_t target[SERVO_CHANNELS];
+
+  if (ch < 0 || ch >= SERVO_CHANNELS)
+    return -1;
+  target[ch] = pulse_us;
+
+  return servo_ctl_move_sync(sc, 1u << ch, target);
+}
+
+int servo_ctl_move_deg(servo_ctl_t *sc, int ch, int32_t mdeg)
+{
+  servo_cfg_t *cfg;
+  int32_t us;
+
+  if (ch < 0 || ch >= SERVO_CHANNELS)
+    return -1;
+
+  pthread_mutex_lock(&sc->lock);
+  cfg = &sc->cfg[ch];
+  if (cfg->max_mdeg == cfg->min_mdeg) {
+    pthread_mutex_unlock(&sc->lock);
+    return -1;
+  }
+  us = cfg->min_us + (int64_t)(mdeg - cfg->min_mdeg) *
+       (cfg->max_us - cfg->min_us) / (cfg->max_mdeg - cfg->min_mdeg);
+  pthread_mutex_unlock(&sc->lock);
+
+  return servo_ctl_move_us(sc, ch, us);
+}
+
+int servo_ctl_move_sync(servo_ctl_t *sc, unsigned mask, const int32_t *pulse_us)
+{
+  int64_t now_ns = servo_now_ns();
+  int64_t t_ns, t_max = 0;
+  uint32_t accel, accel_max = 0x8000;
+  servo_move_t *mv;
+  int ch;
+
+  if (mask & ~((1u << SERVO_CHANNELS) - 1))
+    return -1;
+
+  pthread_mutex_lock(&sc->lock);
+
+  /* moves restart from where the servo is now */
+  for (ch = 0; ch < SERVO_CHANNELS; ch++) {
+    if (!(mask & (1u << ch)))
+      continue;
+    mv = &sc->move[ch];
+    if (mv->active)
+      sc->pos_us[ch] = servo_eval(mv, now_ns);
+    mv->start_us = sc->pos_us[ch];
+    mv->dist_us = servo_clamp_us(&sc->cfg[ch], pulse_us[ch]) - mv->start_us;
+    mv->profile = sc->cfg[ch].profile;
+    mv->start_ns = now_ns;
+    if (mv->profile == SERVO_PROFILE_STEP)
+      continue;
+    t_ns = servo_plan(&sc->cfg[ch], mv->dist_us, &accel);
+    if (t_ns > t_max) {
+      t_max = t_ns;
+      accel_max = accel;
+    }
+  }
+
+  /* every channel follows the shape of the slowest one */
+  for (ch = 0; ch < SERVO_CHANNELS; ch++) {
+    if (!(mask & (1u << ch)))
+      continue;
+    mv = &sc->move[ch];
+    mv->accel_q16 = accel_max;
+    mv->time_ns = mv->profile == SERVO_PROFILE_STEP? 0: t_max;
+    mv->active = 1;
+  }
+
+  pthread_mutex_unlock(&sc->lock);
+
+  return 0;
+}
+
+unsigned servo_ctl_busy(servo_ctl_t *sc)
+{
+  unsigned mask = 0;
+  int ch;
+
+  pthread_mutex_lock(&sc->lock);
+  for (ch = 0; ch < SERVO_CHANNELS; ch++)
+    if (sc->move[ch].active)
+      mask |= 1u << ch;
+  pthread_mutex_unlock(&sc->lock);
+
+  return mask;
+}
+
+int32_t servo_ctl_get_us(servo_ctl_t *sc, int ch)
+{
+  int32_t us;
+
+  pthread_mutex_lock(&sc->lock);
+  us = sc->pos_us[ch];
+  pthread_mutex_unlock(&sc->lock);
+
+  return us;
+}
+
+void servo_ctl_update(servo_ctl_t *sc)
+{
+  int64_t now_ns = servo_now_ns();
+  uint32_t duty;
+  int ch;
+
+  /* all four channels in one pass, servos latch duty per 20 ms frame */
+  pthread_mutex_lock(&sc->lock);
+  for (ch = 0; ch < SERVO_CHANNELS; ch++) {
+    if (sc->move[ch].active)
+      sc->pos_us[ch] = servo_eval(&sc->move[ch], now_ns);
+    duty = sc->pos_us[ch] * SERVO_TICKS_PER_US;
+
+    if (duty == sc->shadow[ch]) {
+      sc->coalesced++;
+      continue;
+    }
+    *(volatile uint32_t *)(sc->servops2_mem_base + servo_reg_offs[ch]) = duty;
+    sc->shadow[ch] = duty;
+    sc->writes++;
+  }
+  pthread_mutex_unlock(&sc->lock);
+}
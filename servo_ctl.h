@@ -0,0 +1,107 @@
+/*******************************************************************
+  Support library for MicroZed based MZ_APO board
+  designed by Petr Porazil at PiKRON
+
+  servo_ctl.h      - RC servo outputs with motion profiles
+
+  license:  any combination of GPL, LGPL, MPL or BSD licenses
+
+ *******************************************************************/
+
+#ifndef SERVO_CTL_H
+#define SERVO_CTL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERVO_CHANNELS       4
+
+/* PWM counter clock of the SERVOPS2 block */
+#define SERVO_PWM_CLK_HZ     50000000
+#define SERVO_FRAME_US       20000
+
+#define SERVO_PROFILE_STEP       0
+#define SERVO_PROFILE_TRAPEZOID  1
+#define SERVO_PROFILE_SCURVE     2
+
+typedef struct servo_cfg_t {
+  int32_t  min_us;          /* pulse at min_mdeg */
+  int32_t  max_us;          /* pulse at max_mdeg */
+  int32_t  min_mdeg;
+  int32_t  max_mdeg;
+  uint32_t vmax;            /* us of pulse width per second */
+  uint32_t amax;            /* us per second^2 */
+  int      profile;
+} servo_cfg_t;
+
+/*
+  Move from start_us by dist_us over time_ns. The normalized shape
+  is shared by all channels of a synchronized move, accel_q16 is the
+  fraction of the time spent accelerating for trapezoid profile.
+*/
+typedef struct servo_move_t {
+  int32_t  start_us;
+  int32_t  dist_us;
+  int64_t  start_ns;
+  int64_t  time_ns;
+  uint32_t accel_q16;
+  int      profile;
+  int      active;
+} servo_move_t;
+
+typedef struct servo_ctl_t {
+  unsigned char  *servops2_mem_base;
+  pthread_mutex_t lock;
+  servo_cfg_t     cfg[SERVO_CHANNELS];
+  servo_move_t    move[SERVO_CHANNELS];
+  int32_t         pos_us[SERVO_CHANNELS];
+  uint32_t        shadow[SERVO_CHANNELS];
+  long            period_ns;
+  int             stop;
+  int             running;
+  pthread_t       thread;
+  unsigned long   writes;
+  unsigned long   coalesced;   /* updates without register write */
+} servo_ctl_t;
+
+/*
+  Sets 20 ms frame, centers and enables all four outputs. With
+  update_hz nonzero a thread advances the moves, otherwise the
+  application calls servo_ctl_update().
+*/
+int servo_ctl_init(servo_ctl_t *sc, unsigned char *servops2_mem_base,
+                   int update_hz);
+
+/* Stops the thread, outputs are left at their last position */
+void servo_ctl_done(servo_ctl_t *sc);
+
+void servo_ctl_config(servo_ctl_t *sc, int ch, const servo_cfg_t *cfg);
+
+/* Moves one channel with its configured profile */
+int servo_ctl_move_us(servo_ctl_t *sc, int ch, int32_t pulse_us);
+
+int servo_ctl_move_deg(servo_ctl_t *sc, int ch, int32_t mdeg);
+
+/*
+  Moves channels selected by mask to pulse_us[ch] so that they start
+  and arrive together, the slowest channel defines the duration.
+*/
+int servo_ctl_move_sync(servo_ctl_t *sc, unsigned mask, const int32_t *pulse_us);
+
+/* Returns mask of channels still moving */
+unsigned servo_ctl_busy(servo_ctl_t *sc);
+
+int32_t servo_ctl_get_us(servo_ctl_t *sc, int ch);
+
+/* Advances moves and writes changed duty registers */
+void servo_ctl_update(servo_ctl_t *sc);
+
+#ifdef __cplusplus
+} /* extern "C"*/
+#endif
+
+#endif  /*SERVO_CTL_H*/